@@ -0,0 +1,29 @@
+// ==============================================================
+//                ORBITER AUX LIBRARY: ModuleMessagingExt
+//         Headless stand-in for EnjoLib's ModuleMessagingExtBase
+//
+// Copyright  (C) 2014-2018 Szymon "Enjo" Ender and Andrew "ADSWNJ" Stokes
+//                         All rights reserved
+//
+// See MMExt2_Advanced.hpp for license information.
+// ==============================================================
+//
+// The core only ever holds pointers to these, so the headless build just needs the type.
+
+#pragma once
+#ifndef MMExt2_StubModuleMessagingExtBase_H
+#define MMExt2_StubModuleMessagingExtBase_H
+namespace EnjoLib
+{
+  class ModuleMessagingExtBase {
+  public:
+    ModuleMessagingExtBase(unsigned int sVer, unsigned int sSize) : _sVer(sVer), _sSize(sSize) {};
+    virtual ~ModuleMessagingExtBase() {};
+    bool IsCorrectVersion(unsigned int sVer) const { return sVer == _sVer; }
+    bool IsCorrectSize(unsigned int sSize) const { return sSize == _sSize; }
+  private:
+    unsigned int _sVer;
+    unsigned int _sSize;
+  };
+}
+#endif // MMExt2_StubModuleMessagingExtBase_H
@@ -0,0 +1,334 @@
+// ==============================================================
+//                ORBITER AUX LIBRARY: ModuleMessagingExt
+//                     Headless microbenchmarks
+//
+// Copyright  (C) 2014-2018 Szymon "Enjo" Ender and Andrew "ADSWNJ" Stokes
+//                         All rights reserved
+//
+// See MMExt2_Advanced.hpp for license information.
+// ==============================================================
+//
+// Times the v1 entry points the way an add-on calls them (each call resolving its key by name), in ns per call:
+//   mmext2_bench [--quick] [--out results.json]
+// Every benchmark runs against each combination of store size (100, 10k, 100k keys) and activity log fill (0, 10k,
+// 100k logged calls; the log itself keeps the last 16K, and each row reports the records it holds), so a cost that
+// grows with either shows up as a trend across the rows. Results go out as JSON, one record per benchmark and configuration, for comparing builds.
+// Vessel handles are checked through a stub object type provider, so handle probes cost a hash lookup.
+// Last, 1, 4 and 16 reader threads Get from one working set while a writer thread keeps Putting to it, once through
+// the seqlock read path and once through the shard lock (SetSeqRead), timed as ns per Get per reader.
+
+#include "MMExt2_Core.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using namespace MMExt2;
+using namespace std;
+
+DLLCLBK bool ModMsgPut_int_v1(const char* mod, const char* var, const int& val, const OBJHANDLE ohv);
+DLLCLBK bool ModMsgPut_bool_v1(const char* mod, const char* var, const bool& val, const OBJHANDLE ohv);
+DLLCLBK bool ModMsgPut_double_v1(const char* mod, const char* var, const double& val, const OBJHANDLE ohv);
+DLLCLBK bool ModMsgPut_VECTOR3_v1(const char* mod, const char* var, const VECTOR3& val, const OBJHANDLE ohv);
+DLLCLBK bool ModMsgPut_MATRIX3_v1(const char* mod, const char* var, const MATRIX3& val, const OBJHANDLE ohv);
+DLLCLBK bool ModMsgPut_MATRIX4_v1(const char* mod, const char* var, const MATRIX4& val, const OBJHANDLE ohv);
+DLLCLBK bool ModMsgPut_OBJHANDLE_v1(const char* mod, const char* var, const OBJHANDLE& val, const OBJHANDLE ohv);
+DLLCLBK bool ModMsgPut_c_str_v1(const char* mod, const char* var, const char* val, const OBJHANDLE ohv);
+DLLCLBK bool ModMsgGet_int_v1(const char* cli, const char* mod, const char* var, int* val, const OBJHANDLE ohv);
+DLLCLBK bool ModMsgGet_bool_v1(const char* cli, const char* mod, const char* var, bool* val, const OBJHANDLE ohv);
+DLLCLBK bool ModMsgGet_double_v1(const char* cli, const char* mod, const char* var, double* val, const OBJHANDLE ohv);
+DLLCLBK bool ModMsgGet_VECTOR3_v1(const char* cli, const char* mod, const char* var, VECTOR3* val, const OBJHANDLE ohv);
+DLLCLBK bool ModMsgGet_MATRIX3_v1(const char* cli, const char* mod, const char* var, MATRIX3* val, const OBJHANDLE ohv);
+DLLCLBK bool ModMsgGet_MATRIX4_v1(const char* cli, const char* mod, const char* var, MATRIX4* val, const OBJHANDLE ohv);
+DLLCLBK bool ModMsgGet_OBJHANDLE_v1(const char* cli, const char* mod, const char* var, OBJHANDLE* val, const OBJHANDLE ohv);
+DLLCLBK bool ModMsgGet_c_str_v1(const char* cli, const char* mod, const char* var, char* val, size_t* lVal, const OBJHANDLE ohv);
+DLLCLBK bool ModMsgFind_v1(char* rTyp, char* rMod, size_t* lMod, char* rVar, size_t* lVar, OBJHANDLE* rOhv, int* ix,
+                           const char* cli, const char* mod, const char* var, const OBJHANDLE ohv, const bool skpSelf);
+DLLCLBK bool ModMsgGet_log_v1(char* rFunc, char* rCli, size_t* lCli, char* rMod, size_t* lMod, char* rVar, size_t* lVar,
+                              char* rVes, size_t* lVes, bool* rSucc, int* ix, const char* get, const bool skp);
+DLLCLBK bool ModMsgRst_log_v1();
+DLLCLBK bool ModMsgSetLogMode_v2(const int mode, const unsigned int sample);
+DLLCLBK bool ModMsgResetSession_v2();
+
+#define VESSELS 100
+#define WORKING_SET 1000  // keys per benchmark, cycled through in turn
+#define LOG_HELD 16384    // the core's LOG_CAPACITY: the activity log keeps the newest 16K records
+
+static unordered_set<OBJHANDLE> s_live;
+static vector<OBJHANDLE> s_ves;
+
+static int _ObjType(OBJHANDLE h) {
+  return (s_live.count(h) ? OBJTP_VESSEL : OBJTP_INVALID);
+}
+
+// Names of the working set keys for one benchmark, built once so the timed loops only pass pointers. Only the first
+// n are used.
+struct Keys {
+  Keys(const char* prefix, const size_t n) : n(n) {
+    char buf[64];
+    for (size_t i = 0; i < n; i++) {
+      snprintf(buf, sizeof(buf), "%s%zu", prefix, i);
+      var.push_back(buf);
+    }
+  }
+  const char* Var(const size_t i) const { return var[i % n].c_str(); }
+  OBJHANDLE Ves(const size_t i) const { return s_ves[(i % n) % VESSELS]; }
+  vector<string> var;
+  size_t n;
+};
+
+struct Result {
+  string op;
+  size_t keys;
+  size_t log;
+  double ns;
+  size_t iters;
+  size_t items;
+  int threads;    // reader threads, for the concurrent runs
+  size_t writes;  // Puts made by the writer thread meanwhile
+};
+
+// Runs fn(i) for i = 0, 1, ... in batches until minMs has passed, and returns ns per call
+static double _Time(const function<void(size_t)>& fn, const double minMs, size_t* iters) {
+  typedef chrono::steady_clock clk;
+  size_t n = 0, batch = 16;
+  clk::time_point t0 = clk::now();
+  double ms = 0;
+  while (ms < minMs) {
+    for (size_t end = n + batch; n < end; n++) fn(n);
+    ms = chrono::duration<double, milli>(clk::now() - t0).count();
+    if (batch < 65536) batch *= 2;
+  }
+  *iters = n;
+  return ms * 1e6 / n;
+}
+
+// readers threads Get VECTOR3 keys round the working set while one writer Puts to the same keys, for minMs. Returns
+// ns per Get as each reader sees it (run time over the Gets one reader made, on average).
+static double _TimeReaders(const vector<MMKey>& keys, const int readers, const double minMs, size_t* gets, size_t* puts) {
+  typedef chrono::steady_clock clk;
+  atomic<bool> stop(false);
+  atomic<int> ready(0);
+  atomic<size_t> total(0);
+  size_t written = 0;
+  vector<thread> pool;
+  for (int r = 0; r < readers; r++) {
+    pool.emplace_back([&, r]() {
+      const char* cli = "BenchRd";
+      VECTOR3 v;
+      size_t n = static_cast<size_t>(r) * 7919;
+      ready++;
+      while (!stop.load(memory_order_relaxed)) {
+        for (int j = 0; j < 64; j++, n++) MMExt2_Core::Get(cli, keys[n % keys.size()], &v);
+      }
+      total += n - static_cast<size_t>(r) * 7919;
+    });
+  }
+  thread writer([&]() {
+    VECTOR3 v = { { 0.0, 0.0, 0.0 } };
+    while (!stop.load(memory_order_relaxed)) {
+      v.x += 1.0;
+      MMExt2_Core::Put(keys[written % keys.size()], v);
+      written++;
+    }
+  });
+  while (ready.load() < readers) this_thread::yield();
+  clk::time_point t0 = clk::now();
+  this_thread::sleep_for(chrono::duration<double, milli>(minMs));
+  stop = true;
+  for (thread& th : pool) th.join();
+  double ms = chrono::duration<double, milli>(clk::now() - t0).count();
+  writer.join();
+  *gets = total.load();
+  *puts = written;
+  return ms * 1e6 * readers / (*gets > 0 ? *gets : 1);
+}
+
+int main(int argc, char** argv) {
+  const char* out = NULL;
+  bool quick = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--quick")) {
+      quick = true;
+    } else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+      out = argv[++i];
+    } else {
+      fprintf(stderr, "usage: %s [--quick] [--out results.json]\n", argv[0]);
+      return 2;
+    }
+  }
+  const double minMs = (quick ? 5.0 : 100.0);
+  const size_t storeSizes[] = { 100, 10000, 100000 };
+  const size_t logSizes[] = { 0, 10000, 100000 };
+  const size_t strSizes[] = { 16, 64, 4096 };
+
+  char name[32];
+  for (int i = 0; i < VESSELS; i++) {
+    snprintf(name, sizeof(name), "BENCH-%03d", i);
+    s_ves.push_back(oapiStubAddVessel(name));
+    s_live.insert(s_ves.back());
+  }
+  oapiStubObjectType(_ObjType);
+  oapiStubSetTime(0.0, 0.0);
+
+  Keys fill("fill", 100000), kInt("int", WORKING_SET), kBool("bool", WORKING_SET), kDbl("dbl", WORKING_SET);
+  Keys kVec("vec", WORKING_SET), kM3("m3", WORKING_SET), kM4("m4", WORKING_SET), kObj("obj", WORKING_SET);
+  Keys kStr("str", WORKING_SET);
+  vector<Result> results;
+
+  for (size_t keys : storeSizes) {
+    for (size_t logN : logSizes) {
+      ModMsgResetSession_v2();
+      ModMsgSetLogMode_v2(MMLOG_FIRST, 0);
+      // The eight working sets below are part of the store under test, so the fill keys only make up the rest of it
+      size_t work = (keys / 8 < WORKING_SET ? keys / 8 : WORKING_SET);
+      size_t filled = keys - 8 * work;
+      for (size_t i = 0; i < filled; i++) ModMsgPut_int_v1("Bench", fill.Var(i), static_cast<int>(i), fill.Ves(i));
+
+      // Fill the log with logN Get records, then go back to the default mode for the timings
+      ModMsgRst_log_v1();
+      ModMsgSetLogMode_v2(MMLOG_FULL, 0);
+      int iv;
+      for (size_t i = 0; i < logN; i++) ModMsgGet_int_v1("BenchLog", "Bench", fill.Var(i % filled), &iv, fill.Ves(i % filled));
+      ModMsgSetLogMode_v2(MMLOG_FIRST, 0);
+      size_t held = (logN < LOG_HELD ? logN : LOG_HELD);
+
+      auto run = [&](const char* op, const function<void(size_t)>& fn, const size_t items) {
+        Result r;
+        r.op = op;
+        r.keys = keys;
+        r.log = held;
+        r.items = items;
+        r.threads = 1;
+        r.writes = 0;
+        r.ns = _Time(fn, minMs, &r.iters);
+        results.push_back(r);
+        fprintf(stderr, "%-16s keys=%-6zu log=%-6zu %10.1f ns/op\n", op, keys, held, r.ns);
+      };
+      Keys* sets[] = { &kInt, &kBool, &kDbl, &kVec, &kM3, &kM4, &kObj, &kStr };
+      for (Keys* k : sets) k->n = work;
+      for (size_t i = 0; i < work; i++) ModMsgPut_c_str_v1("Bench", kStr.Var(i), "", kStr.Ves(i));
+      OBJHANDLE o = s_ves[0];
+      VECTOR3 v = { { 1.0, 2.0, 3.0 } };
+      MATRIX3 m3;
+      MATRIX4 m4;
+      memset(&m3, 0, sizeof(m3));
+      memset(&m4, 0, sizeof(m4));
+
+      run("Put_int",       [&](size_t i) { ModMsgPut_int_v1("Bench", kInt.Var(i), static_cast<int>(i), kInt.Ves(i)); }, 1);
+      run("Put_bool",      [&](size_t i) { ModMsgPut_bool_v1("Bench", kBool.Var(i), (i & 1) != 0, kBool.Ves(i)); }, 1);
+      run("Put_double",    [&](size_t i) { ModMsgPut_double_v1("Bench", kDbl.Var(i), static_cast<double>(i), kDbl.Ves(i)); }, 1);
+      run("Put_VECTOR3",   [&](size_t i) { v.x = static_cast<double>(i); ModMsgPut_VECTOR3_v1("Bench", kVec.Var(i), v, kVec.Ves(i)); }, 1);
+      run("Put_MATRIX3",   [&](size_t i) { m3.m11 = static_cast<double>(i); ModMsgPut_MATRIX3_v1("Bench", kM3.Var(i), m3, kM3.Ves(i)); }, 1);
+      run("Put_MATRIX4",   [&](size_t i) { m4.m11 = static_cast<double>(i); ModMsgPut_MATRIX4_v1("Bench", kM4.Var(i), m4, kM4.Ves(i)); }, 1);
+      run("Put_OBJHANDLE", [&](size_t i) { o = s_ves[i % VESSELS]; ModMsgPut_OBJHANDLE_v1("Bench", kObj.Var(i), o, kObj.Ves(i)); }, 1);
+
+      bool bv;
+      double dv;
+      OBJHANDLE ov;
+      run("Get_int",       [&](size_t i) { ModMsgGet_int_v1("BenchRd", "Bench", kInt.Var(i), &iv, kInt.Ves(i)); }, 1);
+      run("Get_bool",      [&](size_t i) { ModMsgGet_bool_v1("BenchRd", "Bench", kBool.Var(i), &bv, kBool.Ves(i)); }, 1);
+      run("Get_double",    [&](size_t i) { ModMsgGet_double_v1("BenchRd", "Bench", kDbl.Var(i), &dv, kDbl.Ves(i)); }, 1);
+      run("Get_VECTOR3",   [&](size_t i) { ModMsgGet_VECTOR3_v1("BenchRd", "Bench", kVec.Var(i), &v, kVec.Ves(i)); }, 1);
+      run("Get_MATRIX3",   [&](size_t i) { ModMsgGet_MATRIX3_v1("BenchRd", "Bench", kM3.Var(i), &m3, kM3.Ves(i)); }, 1);
+      run("Get_MATRIX4",   [&](size_t i) { ModMsgGet_MATRIX4_v1("BenchRd", "Bench", kM4.Var(i), &m4, kM4.Ves(i)); }, 1);
+      run("Get_OBJHANDLE", [&](size_t i) { ModMsgGet_OBJHANDLE_v1("BenchRd", "Bench", kObj.Var(i), &ov, kObj.Ves(i)); }, 1);
+
+      vector<char> buf(8192);
+      for (size_t len : strSizes) {
+        string s(len, 'x');
+        for (size_t i = 0; i < work; i++) ModMsgPut_c_str_v1("Bench", kStr.Var(i), s.c_str(), kStr.Ves(i));
+        snprintf(name, sizeof(name), "Get_c_str_%zu", len);
+        run(name, [&](size_t i) { size_t l = buf.size(); ModMsgGet_c_str_v1("BenchRd", "Bench", kStr.Var(i), &buf[0], &l, kStr.Ves(i)); }, 1);
+        snprintf(name, sizeof(name), "Put_c_str_%zu", len);
+        run(name, [&](size_t i) { s[0] = static_cast<char>('a' + (i & 15)); ModMsgPut_c_str_v1("Bench", kStr.Var(i), s.c_str(), kStr.Ves(i)); }, 1);
+      }
+
+      // One whole enumeration per call, so ns/op is per pass over the store; items is the matches per pass
+      char typ, rMod[64], rVar[64];
+      size_t lMod, lVar, found = 0;
+      OBJHANDLE rOhv;
+      auto findAll = [&](size_t) {
+        found = 0;
+        for (int ix = 0;; ix++) {
+          lMod = sizeof(rMod);
+          lVar = sizeof(rVar);
+          if (!ModMsgFind_v1(&typ, rMod, &lMod, rVar, &lVar, &rOhv, &ix, "BenchRd", "*", "*", NULL, false)) break;
+          found++;
+        }
+      };
+      findAll(0);
+      run("Find_all", findAll, found);
+
+      char rFunc, rCli[64], rVes[64];
+      size_t lCli, lVes, read = 0;
+      bool rSucc;
+      auto logAll = [&](size_t) {
+        read = 0;
+        for (int ix = 0;;) {  // GetLog moves ix on itself
+          lCli = sizeof(rCli);
+          lMod = sizeof(rMod);
+          lVar = sizeof(rVar);
+          lVes = sizeof(rVes);
+          if (!ModMsgGet_log_v1(&rFunc, rCli, &lCli, rMod, &lMod, rVar, &lVar, rVes, &lVes, &rSucc, &ix, "BenchRd", false)) break;
+          read++;
+        }
+      };
+      logAll(0);
+      run("GetLog_all", logAll, read);
+    }
+  }
+
+  // Concurrent readers against one writer, on the 10k key store
+  {
+    ModMsgResetSession_v2();
+    ModMsgSetLogMode_v2(MMLOG_FIRST, 0);
+    const size_t keys = 10000;
+    for (size_t i = 0; i < keys; i++) ModMsgPut_int_v1("Bench", fill.Var(i), static_cast<int>(i), fill.Ves(i));
+    Keys kMt("mt", WORKING_SET);
+    vector<MMKey> mt(WORKING_SET);
+    VECTOR3 v = { { 1.0, 2.0, 3.0 } };
+    for (size_t i = 0; i < WORKING_SET; i++) {
+      MMExt2_Core::Resolve("Bench", kMt.Var(i), kMt.Ves(i), &mt[i]);
+      MMExt2_Core::Put(mt[i], v);
+    }
+    const int readerCounts[] = { 1, 4, 16 };
+    for (int pass = 0; pass < 2; pass++) {
+      bool seq = (pass == 0);
+      MMExt2_Core::SetSeqRead(seq);
+      for (int readers : readerCounts) {
+        Result r;
+        r.op = (seq ? "MtGet_VECTOR3_seqlock" : "MtGet_VECTOR3_mutex");
+        r.keys = keys + WORKING_SET;
+        r.log = 0;
+        r.items = 1;
+        r.threads = readers;
+        r.ns = _TimeReaders(mt, readers, minMs, &r.iters, &r.writes);
+        results.push_back(r);
+        fprintf(stderr, "%-22s readers=%-3d %10.1f ns/op (%zu Puts)\n", r.op.c_str(), readers, r.ns, r.writes);
+      }
+    }
+    MMExt2_Core::SetSeqRead(true);
+  }
+
+  FILE* f = (out ? fopen(out, "w") : stdout);
+  if (!f) {
+    fprintf(stderr, "%s: cannot write %s\n", argv[0], out);
+    return 1;
+  }
+  fprintf(f, "{\n  \"benchmark\": \"mmext2\",\n  \"quick\": %s,\n  \"results\": [\n", quick ? "true" : "false");
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& r = results[i];
+    fprintf(f, "    { \"op\": \"%s\", \"keys\": %zu, \"log\": %zu, \"ns_per_op\": %.1f, \"iters\": %zu, \"items\": %zu, "
+            "\"threads\": %d, \"writes\": %zu }%s\n",
+            r.op.c_str(), r.keys, r.log, r.ns, r.iters, r.items, r.threads, r.writes, (i + 1 < results.size() ? "," : ""));
+  }
+  fprintf(f, "  ]\n}\n");
+  if (out) fclose(f);
+  return 0;
+}
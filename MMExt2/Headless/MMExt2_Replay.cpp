@@ -0,0 +1,42 @@
+// ==============================================================
+//                ORBITER AUX LIBRARY: ModuleMessagingExt
+//                    Headless replay of a bus recording
+//
+// Copyright  (C) 2014-2018 Szymon "Enjo" Ender and Andrew "ADSWNJ" Stokes
+//                         All rights reserved
+//
+// See MMExt2_Advanced.hpp for license information.
+// ==============================================================
+//
+// Plays a recording made with RecordStart into the headless core, for profiling the core against real traffic:
+//   mmext2_replay <recording> [passes]
+// The vessels named in the recording are made up as they are met. Each pass starts from an empty store.
+
+#include "MMExt2_Core.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace MMExt2;
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <recording> [passes]\n", argv[0]);
+    return 2;
+  }
+  int passes = (argc > 2 ? atoi(argv[2]) : 1);
+  oapiStubAutoVessels(true);
+  for (int i = 0; i < passes; i++) {
+    MMExt2_Core::ResetSession();
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    if (!MMExt2_Core::Replay(argv[1])) {
+      fprintf(stderr, "%s: cannot replay %s\n", argv[0], argv[1]);
+      return 1;
+    }
+    chrono::duration<double, milli> ms = chrono::steady_clock::now() - t0;
+    size_t reserved, used;
+    MMExt2_Core::MemStats(&reserved, &used);
+    printf("pass %d: %.3f ms, %zu bytes in use of %zu reserved\n", i + 1, ms.count(), used, reserved);
+  }
+  return 0;
+}
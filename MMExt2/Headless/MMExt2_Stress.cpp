@@ -0,0 +1,214 @@
+// ==============================================================
+//                ORBITER AUX LIBRARY: ModuleMessagingExt
+//                  Headless multithreaded stress test
+//
+// Copyright  (C) 2014-2018 Szymon "Enjo" Ender and Andrew "ADSWNJ" Stokes
+//                         All rights reserved
+//
+// See MMExt2_Advanced.hpp for license information.
+// ==============================================================
+//
+// Runs Put, Get, Find, GetLog and Delete from N threads at once and checks what comes out, for sanitizer runs:
+//   mmext2_stress [threads] [rounds] [seq]
+// Build with -DMMEXT2_SANITIZE=thread for a data race check. Each thread writes its own module's keys (ints and
+// strings) and a set of keys shared with every other thread, while reading everybody's. Values carry the writer and
+// round, so a reader can tell a torn or out of order value from a merely stale one: a string's tail must agree with
+// its head, and the rounds a reader sees from one writer on one key must never go backwards. At the end every key
+// must hold what its owner wrote last, deleted keys must be gone, and Find must list exactly the live keys.
+// With seq, numeric Gets take the lock free seqlock path even under TSan, and the first thread switches it off and on
+// again as it goes. Run that under TSan with TSAN_OPTIONS=suppressions=MMExt2/Headless/tsan.supp, which excuses only
+// the seqlock's own speculative copy.
+// Exits 0 when every check passes, 1 otherwise.
+
+#include "MMExt2_Core.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace MMExt2;
+using namespace std;
+
+// The seqlock read path copies a value that a writer may be changing, and throws the copy away if it was; TSan has no
+// way to know that, so under TSan the fixed size Gets take the shard lock like every other read unless seq is given.
+#if defined(__SANITIZE_THREAD__)
+#define STRESS_TSAN 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define STRESS_TSAN 1
+#endif
+#endif
+
+#define VARS 64      // keys of each kind per thread
+#define SHARED 16    // keys every thread writes
+#define DEL_EVERY 5  // every fifth own key is deleted once its owner is done with it
+
+static atomic<unsigned int> s_fails(0);
+
+static void _Fail(const char* what, const int t, const int i) {
+  if (s_fails.fetch_add(1) < 20) fprintf(stderr, "FAIL: %s (thread %d, key %d)\n", what, t, i);
+}
+
+// An int value packs its writer and round; a string value is its writer and round, padded out to a length that moves
+// with the round (from inline to pooled sizes), and closed by the same pair so that a torn copy shows.
+static int _Pack(const int t, const int r) { return t * 1000000 + r; }
+
+static string _Str(const int t, const int r) {
+  char head[32];
+  snprintf(head, sizeof(head), "%d:%d:", t, r);
+  string s(head);
+  s.append(static_cast<size_t>(r % 7) * 37, '.');
+  s.append(head);
+  return s;
+}
+
+static bool _StrOk(const char* s, int* t, int* r) {
+  if (sscanf(s, "%d:%d:", t, r) != 2) return false;
+  return _Str(*t, *r) == s;
+}
+
+struct Keys {
+  vector<MMKey> num, str;
+};
+
+int main(int argc, char** argv) {
+  const int threads = (argc > 1 ? atoi(argv[1]) : 8);
+  const int rounds = (argc > 2 ? atoi(argv[2]) : 2000);
+  const bool seq = (argc > 3 && !strcmp(argv[3], "seq"));
+  if (threads < 1 || rounds < 1 || (argc > 3 && !seq)) {
+    fprintf(stderr, "usage: %s [threads] [rounds] [seq]\n", argv[0]);
+    return 2;
+  }
+  MMExt2_Core::SetLogMode(MMLOG_FULL, 0);
+#ifdef STRESS_TSAN
+  MMExt2_Core::SetSeqRead(seq);
+#endif
+  OBJHANDLE ves[4];
+  char mod[32], var[32];
+  for (int v = 0; v < 4; v++) {
+    snprintf(var, sizeof(var), "STRESS-%d", v);
+    ves[v] = oapiStubAddVessel(var);
+  }
+
+  // Keys are resolved here, on the "sim thread", as the Threading notes in MMExt2_Core.hpp ask
+  vector<Keys> own(threads);
+  vector<MMKey> shared(SHARED);
+  for (int t = 0; t < threads; t++) {
+    snprintf(mod, sizeof(mod), "Stress%d", t);
+    for (int i = 0; i < VARS; i++) {
+      MMKey k;
+      snprintf(var, sizeof(var), "num%d", i);
+      if (!MMExt2_Core::Resolve(mod, var, ves[i % 4], &k)) _Fail("Resolve", t, i);
+      own[t].num.push_back(k);
+      snprintf(var, sizeof(var), "str%d", i);
+      if (!MMExt2_Core::Resolve(mod, var, ves[i % 4], &k)) _Fail("Resolve", t, i);
+      own[t].str.push_back(k);
+    }
+  }
+  for (int i = 0; i < SHARED; i++) {
+    snprintf(var, sizeof(var), "shared%d", i);
+    if (!MMExt2_Core::Resolve("StressShared", var, ves[0], &shared[i])) _Fail("Resolve", -1, i);
+  }
+
+  vector<thread> pool;
+  for (int t = 0; t < threads; t++) {
+    pool.emplace_back([&, t]() {
+      char cli[32], oMod[32];
+      snprintf(cli, sizeof(cli), "Stress%d", t);
+      vector<int> seen(static_cast<size_t>(SHARED) * threads, -1);  // last round seen from each writer on each shared key
+      char buf[512];
+      for (int r = 0; r < rounds; r++) {
+        int i = r % VARS;
+        if (!MMExt2_Core::Put(own[t].num[i], _Pack(t, r))) _Fail("Put int", t, i);
+        if (!MMExt2_Core::Put(own[t].str[i], _Str(t, r).c_str())) _Fail("Put string", t, i);
+        int s = r % SHARED;
+        if (!MMExt2_Core::Put(shared[s], _Pack(t, r))) _Fail("Put shared", t, s);
+        if (seq && t == 0 && r % 101 == 0) MMExt2_Core::SetSeqRead(r % 202 != 0 || r + 101 >= rounds);
+
+        // Another thread's keys: whatever is there must be that thread's own, and well formed
+        int o = (t + 1 + r) % threads, iv, wt, wr;
+        if (MMExt2_Core::Get(cli, own[o].num[i], &iv) && iv / 1000000 != o) _Fail("Get int from the wrong writer", o, i);
+        size_t len = sizeof(buf);
+        if (MMExt2_Core::GetCopy(cli, own[o].str[i], buf, &len) && (!_StrOk(buf, &wt, &wr) || wt != o)) _Fail("Get torn string", o, i);
+        for (int k = 0; k < SHARED; k += 5) {
+          if (!MMExt2_Core::Get(cli, shared[k], &iv)) continue;
+          wt = iv / 1000000;
+          wr = iv % 1000000;
+          if (wt < 0 || wt >= threads || wr >= rounds) {
+            _Fail("Get shared out of range", t, k);
+            continue;
+          }
+          int& last = seen[static_cast<size_t>(k) * threads + wt];
+          if (wr < last) _Fail("Get shared went backwards", t, k);
+          last = wr;
+        }
+
+        if (r % 97 == 0) {
+          MMCursor cur;
+          char typ;
+          string rMod, rVar;
+          OBJHANDLE rOhv;
+          snprintf(oMod, sizeof(oMod), "Stress%d", o);
+          while (MMExt2_Core::Find(&typ, &rMod, &rVar, &rOhv, &cur, cli, oMod, "*", NULL, false)) {
+            if (rMod != oMod || (typ != 'i' && typ != 's')) _Fail("Find match", o, -1);
+          }
+        }
+        if (r % 211 == 0) {
+          char func;
+          string lCli, lMod, lVar, lVes;
+          bool succ;
+          int ix = 0;
+          for (int n = 0; n < 64 && MMExt2_Core::GetLog(&func, &lCli, &lMod, &lVar, &lVes, &succ, &ix, cli, false); n++) {
+            if (lCli.empty() || lMod.empty()) _Fail("GetLog record", t, ix);
+          }
+        }
+      }
+      // The last round's values stay; then every DEL_EVERY'th key goes
+      for (int i = 0; i < VARS; i += DEL_EVERY) {
+        if (!MMExt2_Core::Delete(cli, own[t].num[i])) _Fail("Delete int", t, i);
+        if (!MMExt2_Core::Delete(cli, own[t].str[i])) _Fail("Delete string", t, i);
+      }
+    });
+  }
+  for (thread& th : pool) th.join();
+
+  // Final state: each key holds the last round its owner wrote to it, or nothing if it was deleted
+  for (int t = 0; t < threads; t++) {
+    snprintf(mod, sizeof(mod), "Stress%d", t);
+    size_t live = 0;
+    for (int i = 0; i < VARS; i++) {
+      int last = -1;
+      for (int r = i; r < rounds; r += VARS) last = r;
+      int iv;
+      char buf[512];
+      size_t len = sizeof(buf);
+      bool hasNum = MMExt2_Core::Get("StressCheck", own[t].num[i], &iv);
+      bool hasStr = MMExt2_Core::GetCopy("StressCheck", own[t].str[i], buf, &len);
+      if (i % DEL_EVERY == 0 || last < 0) {
+        if (hasNum || hasStr) _Fail("deleted or unwritten key still there", t, i);
+        continue;
+      }
+      if (!hasNum || iv != _Pack(t, last)) _Fail("final int", t, i);
+      if (!hasStr || _Str(t, last) != buf) _Fail("final string", t, i);
+      live += 2;
+    }
+    MMCursor cur;
+    char typ;
+    string rMod, rVar;
+    OBJHANDLE rOhv;
+    size_t found = 0;
+    while (MMExt2_Core::Find(&typ, &rMod, &rVar, &rOhv, &cur, "StressCheck", mod, "*", NULL, false)) found++;
+    if (found != live) _Fail("Find count", t, static_cast<int>(found));
+  }
+  for (int s = 0; s < SHARED; s++) {
+    int iv;
+    if (s < rounds && (!MMExt2_Core::Get("StressCheck", shared[s], &iv) || iv / 1000000 >= threads)) _Fail("final shared", -1, s);
+  }
+
+  unsigned int fails = s_fails.load();
+  printf("%d threads x %d rounds: %s (%u failed checks)\n", threads, rounds, (fails ? "FAIL" : "ok"), fails);
+  return (fails ? 1 : 0);
+}
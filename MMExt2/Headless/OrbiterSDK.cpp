@@ -0,0 +1,117 @@
+// ==============================================================
+//                ORBITER AUX LIBRARY: ModuleMessagingExt
+//                     Headless stand-in for OrbiterSDK
+//
+// Copyright  (C) 2014-2018 Szymon "Enjo" Ender and Andrew "ADSWNJ" Stokes
+//                         All rights reserved
+//
+// See MMExt2_Advanced.hpp for license information.
+// ==============================================================
+
+#include "OrbiterSDK.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// The live vessels, by handle and by name. A vessel's VESSEL object is its handle, and is kept (in s_gone) after it
+// is deleted, so its address is never reused.
+static mutex s_lock;
+static map<OBJHANDLE, unique_ptr<VESSEL>> s_vessels;
+static map<string, OBJHANDLE> s_byName;
+static vector<unique_ptr<VESSEL>> s_gone;
+static bool s_auto = false;
+static atomic<OAPISTUB_OBJTYPE> s_typeFn(nullptr);
+static atomic<double> s_simt(0.0);
+static atomic<double> s_syst(0.0);
+
+VESSEL::VESSEL(OBJHANDLE hVessel, const char* name) : m_h(hVessel) {
+  snprintf(m_name, sizeof(m_name), "%s", name);
+}
+
+const char* VESSEL::GetName() const { return m_name; }
+OBJHANDLE VESSEL::GetHandle() const { return m_h; }
+
+// Called with s_lock held
+static OBJHANDLE _Add(const char* name) {
+  unique_ptr<VESSEL> v(new VESSEL(NULL, name));
+  OBJHANDLE h = v.get();
+  *v = VESSEL(h, name);
+  s_vessels[h] = move(v);
+  s_byName[name] = h;
+  return h;
+}
+
+int oapiGetObjectType(OBJHANDLE hObj) {
+  OAPISTUB_OBJTYPE fn = s_typeFn.load();
+  if (fn) return fn(hObj);
+  lock_guard<mutex> lk(s_lock);
+  return (s_vessels.count(hObj) ? OBJTP_VESSEL : OBJTP_INVALID);
+}
+
+void oapiGetObjectName(OBJHANDLE hObj, char* name, int n) {
+  lock_guard<mutex> lk(s_lock);
+  map<OBJHANDLE, unique_ptr<VESSEL>>::const_iterator it = s_vessels.find(hObj);
+  snprintf(name, n, "%s", (it == s_vessels.end() ? "" : it->second->GetName()));
+}
+
+OBJHANDLE oapiGetObjectByName(char* name) {
+  lock_guard<mutex> lk(s_lock);
+  map<string, OBJHANDLE>::const_iterator it = s_byName.find(name);
+  return (it == s_byName.end() ? NULL : it->second);
+}
+
+OBJHANDLE oapiGetVesselByName(char* name) {
+  lock_guard<mutex> lk(s_lock);
+  map<string, OBJHANDLE>::const_iterator it = s_byName.find(name);
+  if (it != s_byName.end()) return it->second;
+  return (s_auto && name[0] ? _Add(name) : NULL);
+}
+
+VESSEL* oapiGetVesselInterface(OBJHANDLE hVessel) {
+  lock_guard<mutex> lk(s_lock);
+  map<OBJHANDLE, unique_ptr<VESSEL>>::const_iterator it = s_vessels.find(hVessel);
+  return (it == s_vessels.end() ? NULL : it->second.get());
+}
+
+double oapiGetSimTime() { return s_simt.load(); }
+double oapiGetSysTime() { return s_syst.load(); }
+
+OBJHANDLE oapiStubAddVessel(const char* name) {
+  lock_guard<mutex> lk(s_lock);
+  if (s_byName.count(name)) return NULL;
+  return _Add(name);
+}
+
+bool oapiStubDelVessel(OBJHANDLE hVessel) {
+  lock_guard<mutex> lk(s_lock);
+  map<OBJHANDLE, unique_ptr<VESSEL>>::iterator it = s_vessels.find(hVessel);
+  if (it == s_vessels.end()) return false;
+  s_byName.erase(it->second->GetName());
+  s_gone.push_back(move(it->second));
+  s_vessels.erase(it);
+  return true;
+}
+
+void oapiStubAutoVessels(bool on) {
+  lock_guard<mutex> lk(s_lock);
+  s_auto = on;
+}
+
+void oapiStubObjectType(OAPISTUB_OBJTYPE fn) { s_typeFn.store(fn); }
+
+void oapiStubSetTime(double simt, double syst) {
+  s_simt.store(simt);
+  s_syst.store(syst);
+}
+
+void oapiStubStep(double dt) {
+  s_simt.store(s_simt.load() + dt);
+  s_syst.store(s_syst.load() + dt);
+}
@@ -0,0 +1,80 @@
+// ==============================================================
+//                ORBITER AUX LIBRARY: ModuleMessagingExt
+//                     Headless stand-in for OrbiterSDK.h
+//
+// Copyright  (C) 2014-2018 Szymon "Enjo" Ender and Andrew "ADSWNJ" Stokes
+//                         All rights reserved
+//
+// See MMExt2_Advanced.hpp for license information.
+// ==============================================================
+//
+// Just enough of the Orbiter API for MMExt2_Core.cpp to build and run outside Orbiter (on Linux, under perf or the
+// sanitizers): the value types, OBJHANDLE, and the handful of oapi calls the core makes. There is no simulation behind
+// it. The host program makes the vessels and moves the clock itself, with the oapiStub calls at the bottom.
+// Never include this in an Orbiter build: the real OrbiterSDK.h comes first on the include path there.
+
+#pragma once
+#ifndef MMExt2_StubOrbiterSDK_H
+#define MMExt2_StubOrbiterSDK_H
+#include <cstddef>
+
+#ifdef _WIN32
+#define DLLCLBK extern "C" __declspec(dllexport)
+#else
+#define DLLCLBK extern "C" __attribute__((visibility("default")))
+#endif
+
+typedef void* OBJHANDLE;
+
+typedef union {
+  double data[3];
+  struct { double x, y, z; };
+} VECTOR3;
+
+typedef union {
+  double data[9];
+  struct { double m11, m12, m13, m21, m22, m23, m31, m32, m33; };
+} MATRIX3;
+
+typedef union {
+  double data[16];
+  struct { double m11, m12, m13, m14, m21, m22, m23, m24, m31, m32, m33, m34, m41, m42, m43, m44; };
+} MATRIX4;
+
+#define OBJTP_INVALID 0
+#define OBJTP_GENERIC 1
+#define OBJTP_CBODY 2
+#define OBJTP_STAR 3
+#define OBJTP_PLANET 4
+#define OBJTP_VESSEL 10
+#define OBJTP_SURFBASE 20
+
+class VESSEL {
+public:
+  VESSEL(OBJHANDLE hVessel, const char* name);
+  const char* GetName() const;
+  OBJHANDLE GetHandle() const;
+private:
+  OBJHANDLE m_h;
+  char m_name[256];
+};
+
+int oapiGetObjectType(OBJHANDLE hObj);
+void oapiGetObjectName(OBJHANDLE hObj, char* name, int n);
+OBJHANDLE oapiGetObjectByName(char* name);
+OBJHANDLE oapiGetVesselByName(char* name);
+VESSEL* oapiGetVesselInterface(OBJHANDLE hVessel);
+double oapiGetSimTime();
+double oapiGetSysTime();
+
+// Host controls, not part of the Orbiter API. A deleted vessel's handle is never handed out again, so stale handles
+// stay detectably stale. The object type callback, when set, answers oapiGetObjectType in place of the vessel list.
+typedef int (*OAPISTUB_OBJTYPE)(OBJHANDLE hObj);
+OBJHANDLE oapiStubAddVessel(const char* name);
+bool oapiStubDelVessel(OBJHANDLE hVessel);
+void oapiStubAutoVessels(bool on);           // oapiGetVesselByName adds any vessel it has not heard of, e.g. for replays
+void oapiStubObjectType(OAPISTUB_OBJTYPE fn);
+void oapiStubSetTime(double simt, double syst);
+void oapiStubStep(double dt);                 // one frame: both clocks move on by dt
+
+#endif // MMExt2_StubOrbiterSDK_H
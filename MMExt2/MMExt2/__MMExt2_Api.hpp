@@ -0,0 +1,192 @@
+// =======================================================================
+//         ORBITER AUX LIBRARY: Module Messaging Extended v2a
+//                              DLL Interface function table header
+//
+// Copyright  (C) 2014-2018 Szymon "Enjo" Ender and Andrew "ADSWNJ" Stokes
+//                         All rights reserved
+//
+// See MMExt2_Advanced.hpp for license and usage information.
+// This is an internal implementation file. Do not include this directly
+// in your code. To use, refer to the documentation in the Orbitersdk\Doc
+// folder.
+// =======================================================================
+#pragma once
+#ifndef MMExt2_Api_H
+#define MMExt2_Api_H
+namespace MMExt2
+{
+  // Function prototypes for the DLL Interface. (Include orbitersdk.h and the MMStruct and MMBase headers first.)
+  typedef bool (*FUNC_MMEXT2_PUT_INT) (                 const char* mod, const char* var, const int& val,           const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_PUT_BOO) (                 const char* mod, const char* var, const bool& val,          const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_PUT_DBL) (                 const char* mod, const char* var, const double& val,        const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_PUT_VEC) (                 const char* mod, const char* var, const VECTOR3& val,       const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_PUT_MX3) (                 const char* mod, const char* var, const MATRIX3& val,       const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_PUT_MX4) (                 const char* mod, const char* var, const MATRIX4& val,       const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_PUT_OBJ) (                 const char* mod, const char* var, const OBJHANDLE& val,     const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_PUT_CST) (                 const char* mod, const char* var, const char *val,          const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_DEL_ANY) (                 const char* mod, const char* var,                           const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_GET_INT) (const char* cli, const char* mod, const char* var, int* val,                 const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_GET_BOO) (const char* cli, const char* mod, const char* var, bool* val,                const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_GET_DBL) (const char* cli, const char* mod, const char* var, double* val,              const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_GET_VEC) (const char* cli, const char* mod, const char* var, VECTOR3* val,             const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_GET_MX3) (const char* cli, const char* mod, const char* var, MATRIX3* val,             const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_GET_MX4) (const char* cli, const char* mod, const char* var, MATRIX4* val,             const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_GET_OBJ) (const char* cli, const char* mod, const char* var, OBJHANDLE* val,           const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_GET_CST) (const char* cli, const char* mod, const char* var, char* val, size_t *len,   const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_GET_VER) (const char* mod, char* var, size_t* len);
+  typedef bool (*FUNC_MMEXT2_GET_LOG) (char* rFunc, char *rCli, size_t *lCli, char *rMod, size_t *lMod, char *rVar, size_t *lVar, char *rVes, size_t *lVes, bool* rSucc, int* ix,
+                                       const char* cli, const bool skpSelf);
+  typedef bool (*FUNC_MMEXT2_FIND)    (char *rTyp, char *rMod, size_t *lMod, char *rVar, size_t *lVar, OBJHANDLE* rOhv, int* ix,
+                                       const char* cli, const char* mod, const char* var, const OBJHANDLE ohv, const bool skpSelf);
+  typedef bool (*FUNC_MMEXT2_PUT_MMB) (const char* mod, const char* var, const EnjoLib::ModuleMessagingExtBase* val, const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_PUT_MMS) (const char* mod, const char* var, const MMStruct* val, const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_GET_MMB) (const char* cli, const char* mod, const char* var, const EnjoLib::ModuleMessagingExtBase** val, const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_GET_MMS) (const char* cli, const char* mod, const char* var, const MMStruct** val, const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_RST_LOG) ();
+  typedef int  (*FUNC_MMEXT2_OBJ_TYP) (const OBJHANDLE& val);
+  typedef bool (*FUNC_MMEXT2_RESOLVE) (                 const char* mod, const char* var, MMKey* key,               const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_PUT_INT_KEY) (                               const MMKey& key, const int& val);
+  typedef bool (*FUNC_MMEXT2_PUT_BOO_KEY) (                               const MMKey& key, const bool& val);
+  typedef bool (*FUNC_MMEXT2_PUT_DBL_KEY) (                               const MMKey& key, const double& val);
+  typedef bool (*FUNC_MMEXT2_PUT_VEC_KEY) (                               const MMKey& key, const VECTOR3& val);
+  typedef bool (*FUNC_MMEXT2_PUT_MX3_KEY) (                               const MMKey& key, const MATRIX3& val);
+  typedef bool (*FUNC_MMEXT2_PUT_MX4_KEY) (                               const MMKey& key, const MATRIX4& val);
+  typedef bool (*FUNC_MMEXT2_PUT_OBJ_KEY) (                               const MMKey& key, const OBJHANDLE& val);
+  typedef bool (*FUNC_MMEXT2_PUT_CST_KEY) (                               const MMKey& key, const char* val);
+  typedef bool (*FUNC_MMEXT2_GET_INT_KEY) (const char* cli,               const MMKey& key, int* val);
+  typedef bool (*FUNC_MMEXT2_GET_BOO_KEY) (const char* cli,               const MMKey& key, bool* val);
+  typedef bool (*FUNC_MMEXT2_GET_DBL_KEY) (const char* cli,               const MMKey& key, double* val);
+  typedef bool (*FUNC_MMEXT2_GET_VEC_KEY) (const char* cli,               const MMKey& key, VECTOR3* val);
+  typedef bool (*FUNC_MMEXT2_GET_MX3_KEY) (const char* cli,               const MMKey& key, MATRIX3* val);
+  typedef bool (*FUNC_MMEXT2_GET_MX4_KEY) (const char* cli,               const MMKey& key, MATRIX4* val);
+  typedef bool (*FUNC_MMEXT2_GET_OBJ_KEY) (const char* cli,               const MMKey& key, OBJHANDLE* val);
+  typedef bool (*FUNC_MMEXT2_GET_CST_KEY) (const char* cli,               const MMKey& key, char* val, size_t *len);
+  typedef bool (*FUNC_MMEXT2_CHG_INT) (const char* cli,               const MMKey& key, int* val,                unsigned int* gen);
+  typedef bool (*FUNC_MMEXT2_CHG_BOO) (const char* cli,               const MMKey& key, bool* val,               unsigned int* gen);
+  typedef bool (*FUNC_MMEXT2_CHG_DBL) (const char* cli,               const MMKey& key, double* val,             unsigned int* gen);
+  typedef bool (*FUNC_MMEXT2_CHG_VEC) (const char* cli,               const MMKey& key, VECTOR3* val,            unsigned int* gen);
+  typedef bool (*FUNC_MMEXT2_CHG_MX3) (const char* cli,               const MMKey& key, MATRIX3* val,            unsigned int* gen);
+  typedef bool (*FUNC_MMEXT2_CHG_MX4) (const char* cli,               const MMKey& key, MATRIX4* val,            unsigned int* gen);
+  typedef bool (*FUNC_MMEXT2_CHG_OBJ) (const char* cli,               const MMKey& key, OBJHANDLE* val,          unsigned int* gen);
+  typedef bool (*FUNC_MMEXT2_CHG_CST) (const char* cli,               const MMKey& key, char* val, size_t *len,  unsigned int* gen);
+  typedef bool (*FUNC_MMEXT2_GET_BAT) (const char* cli, MMBatchItem* items, const size_t n);
+  typedef bool (*FUNC_MMEXT2_PUT_BAT) (const char* mod, MMBatchItem* items, const size_t n);
+  typedef bool (*FUNC_MMEXT2_SET_LOG) (const int mode, const unsigned int sample);
+  typedef bool (*FUNC_MMEXT2_FIND_ALL)(MMFindRec* rRec, size_t* nRec, char* rNames, size_t* lNames,
+                                       const char* cli, const char* mod, const char* var, const OBJHANDLE ohv, const bool skpSelf);
+  typedef bool (*FUNC_MMEXT2_FIND_CUR)(char *rTyp, char *rMod, size_t *lMod, char *rVar, size_t *lVar, OBJHANDLE* rOhv, MMCursor* cur,
+                                       const char* cli, const char* mod, const char* var, const OBJHANDLE ohv, const bool skpSelf);
+  typedef bool (*FUNC_MMEXT2_SUBSCRIBE)(unsigned int* id, const char* cli, const char* mod, const char* var, const OBJHANDLE ohv,
+                                        MMNotifyFunc fn, void* ctx, const int mode, const bool skpSelf);
+  typedef bool (*FUNC_MMEXT2_UNSUBSCRIBE)(const char* cli, const unsigned int id);
+  typedef bool (*FUNC_MMEXT2_DISPATCH)(const char* cli);
+  typedef bool (*FUNC_MMEXT2_VES_EVT) (const char* cli, const bool on);
+  typedef bool (*FUNC_MMEXT2_VES_DEL) (const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_OBJ_STA) (unsigned long long* hits, unsigned long long* misses);
+  typedef bool (*FUNC_MMEXT2_REF_CST) (const char* cli,               const MMKey& key, const char** val, size_t *len, unsigned int* gen);
+  typedef bool (*FUNC_MMEXT2_REF_CST_NAME) (const char* cli, const char* mod, const char* var, const char** val, size_t *len, const OBJHANDLE ohv);
+  typedef bool (*FUNC_MMEXT2_REF_VER) (const char* mod, const char** ver);
+  typedef bool (*FUNC_MMEXT2_REF_LOG) (char* rFunc, const char** rCli, const char** rMod, const char** rVar, const char** rVes, bool* rSucc, int* ix,
+                                       const char* cli, const bool skpSelf);
+  typedef bool (*FUNC_MMEXT2_REF_FIND)(char *rTyp, const char** rMod, const char** rVar, OBJHANDLE* rOhv, MMCursor* cur,
+                                       const char* cli, const char* mod, const char* var, const OBJHANDLE ohv, const bool skpSelf);
+  typedef bool (*FUNC_MMEXT2_MEM_STA) (size_t* reserved, size_t* used);
+  typedef bool (*FUNC_MMEXT2_RST_SES) ();
+  typedef bool (*FUNC_MMEXT2_SNAP)    (const char* path);
+  typedef bool (*FUNC_MMEXT2_RESTORE) (const char* path);
+  typedef bool (*FUNC_MMEXT2_REC_BEG) (const char* path);
+  typedef bool (*FUNC_MMEXT2_REC_STP) ();
+  typedef bool (*FUNC_MMEXT2_REPLAY)  (const char* path);
+  typedef bool (*FUNC_MMEXT2_TRC_BEG) (const char* path);
+  typedef bool (*FUNC_MMEXT2_TRC_STP) ();
+  typedef bool (*FUNC_MMEXT2_STATS)   (const unsigned int ix, const char** rCli, const int op, MMStats* stats);
+  typedef bool (*FUNC_MMEXT2_HOT_KEYS)(MMHotKey* rKeys, size_t* nKeys, char* rNames, size_t* lNames);
+
+
+  // Every entry point in one table, from ModMsgGetApi_v2. Entries are only ever added at the end, with the version
+  // bumped, so a table is good for any client built against the same or an earlier version of this header.
+  const unsigned int MMEXT2_API_VERSION = 1;
+  struct MMApi {
+    unsigned int version;
+    FUNC_MMEXT2_PUT_INT fPI;
+    FUNC_MMEXT2_PUT_BOO fPB;
+    FUNC_MMEXT2_PUT_DBL fPD;
+    FUNC_MMEXT2_PUT_VEC fPV;
+    FUNC_MMEXT2_PUT_MX3 fP3;
+    FUNC_MMEXT2_PUT_MX4 fP4;
+    FUNC_MMEXT2_PUT_OBJ fPO;
+    FUNC_MMEXT2_PUT_CST fPS;
+    FUNC_MMEXT2_GET_INT fGI;
+    FUNC_MMEXT2_GET_BOO fGB;
+    FUNC_MMEXT2_GET_DBL fGD;
+    FUNC_MMEXT2_GET_VEC fGV;
+    FUNC_MMEXT2_GET_MX3 fG3;
+    FUNC_MMEXT2_GET_MX4 fG4;
+    FUNC_MMEXT2_GET_OBJ fGO;
+    FUNC_MMEXT2_GET_CST fGS;
+    FUNC_MMEXT2_DEL_ANY fDA;
+    FUNC_MMEXT2_GET_VER fVR;
+    FUNC_MMEXT2_GET_LOG fGL;
+    FUNC_MMEXT2_FIND fFA;
+    FUNC_MMEXT2_PUT_MMB fPY;
+    FUNC_MMEXT2_PUT_MMS fPX;
+    FUNC_MMEXT2_GET_MMB fGY;
+    FUNC_MMEXT2_GET_MMS fGX;
+    FUNC_MMEXT2_RST_LOG fRL;
+    FUNC_MMEXT2_OBJ_TYP fOT;
+    FUNC_MMEXT2_RESOLVE fRK;
+    FUNC_MMEXT2_PUT_INT_KEY fPIK;
+    FUNC_MMEXT2_PUT_BOO_KEY fPBK;
+    FUNC_MMEXT2_PUT_DBL_KEY fPDK;
+    FUNC_MMEXT2_PUT_VEC_KEY fPVK;
+    FUNC_MMEXT2_PUT_MX3_KEY fP3K;
+    FUNC_MMEXT2_PUT_MX4_KEY fP4K;
+    FUNC_MMEXT2_PUT_OBJ_KEY fPOK;
+    FUNC_MMEXT2_PUT_CST_KEY fPSK;
+    FUNC_MMEXT2_GET_INT_KEY fGIK;
+    FUNC_MMEXT2_GET_BOO_KEY fGBK;
+    FUNC_MMEXT2_GET_DBL_KEY fGDK;
+    FUNC_MMEXT2_GET_VEC_KEY fGVK;
+    FUNC_MMEXT2_GET_MX3_KEY fG3K;
+    FUNC_MMEXT2_GET_MX4_KEY fG4K;
+    FUNC_MMEXT2_GET_OBJ_KEY fGOK;
+    FUNC_MMEXT2_GET_CST_KEY fGSK;
+    FUNC_MMEXT2_SET_LOG fSL;
+    FUNC_MMEXT2_FIND_CUR fFC;
+    FUNC_MMEXT2_FIND_ALL fFL;
+    FUNC_MMEXT2_GET_BAT fGM;
+    FUNC_MMEXT2_PUT_BAT fPM;
+    FUNC_MMEXT2_SUBSCRIBE fSB;
+    FUNC_MMEXT2_UNSUBSCRIBE fUS;
+    FUNC_MMEXT2_DISPATCH fDS;
+    FUNC_MMEXT2_VES_EVT fVE;
+    FUNC_MMEXT2_VES_DEL fVD;
+    FUNC_MMEXT2_OBJ_STA fOS;
+    FUNC_MMEXT2_CHG_INT fCI;
+    FUNC_MMEXT2_CHG_BOO fCB;
+    FUNC_MMEXT2_CHG_DBL fCD;
+    FUNC_MMEXT2_CHG_VEC fCV;
+    FUNC_MMEXT2_CHG_MX3 fC3;
+    FUNC_MMEXT2_CHG_MX4 fC4;
+    FUNC_MMEXT2_CHG_OBJ fCO;
+    FUNC_MMEXT2_CHG_CST fCS;
+    FUNC_MMEXT2_REF_CST fRS;
+    FUNC_MMEXT2_REF_VER fRV;
+    FUNC_MMEXT2_REF_LOG fRG;
+    FUNC_MMEXT2_REF_FIND fRF;
+    FUNC_MMEXT2_MEM_STA fMS;
+    FUNC_MMEXT2_RST_SES fSR;
+    FUNC_MMEXT2_SNAP fSN;
+    FUNC_MMEXT2_RESTORE fRE;
+    FUNC_MMEXT2_REC_BEG fRB;
+    FUNC_MMEXT2_REC_STP fRX;
+    FUNC_MMEXT2_REPLAY fRP;
+    FUNC_MMEXT2_TRC_BEG fTB;
+    FUNC_MMEXT2_TRC_STP fTX;
+    FUNC_MMEXT2_STATS fST;
+    FUNC_MMEXT2_HOT_KEYS fHK;
+    FUNC_MMEXT2_REF_CST_NAME fRN;
+  };
+  typedef const MMApi* (*FUNC_MMEXT2_GET_API)(const unsigned int version);
+}
+#endif // MMExt2_Api_H
@@ -15,118 +15,175 @@
 #include "windows.h"
 #include "orbitersdk.h"
 #include <string>
+#include <vector>
+#include <atomic>
 #include <exception>
+#include <mutex>
 #include "__MMExt2_MMStruct.hpp"
+#include "__MMExt2_Types.hpp"
 #include "EnjoLib\ModuleMessagingExtBase.hpp"
+#include "__MMExt2_Api.hpp"
 
 using namespace std;
 namespace MMExt2
 {
-  // Function prototypes for the DLL Interface
-  typedef bool (*FUNC_MMEXT2_PUT_INT) (                 const char* mod, const char* var, const int& val,           const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_PUT_BOO) (                 const char* mod, const char* var, const bool& val,          const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_PUT_DBL) (                 const char* mod, const char* var, const double& val,        const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_PUT_VEC) (                 const char* mod, const char* var, const VECTOR3& val,       const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_PUT_MX3) (                 const char* mod, const char* var, const MATRIX3& val,       const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_PUT_MX4) (                 const char* mod, const char* var, const MATRIX4& val,       const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_PUT_OBJ) (                 const char* mod, const char* var, const OBJHANDLE& val,     const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_PUT_CST) (                 const char* mod, const char* var, const char *val,          const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_DEL_ANY) (                 const char* mod, const char* var,                           const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_GET_INT) (const char* cli, const char* mod, const char* var, int* val,                 const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_GET_BOO) (const char* cli, const char* mod, const char* var, bool* val,                const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_GET_DBL) (const char* cli, const char* mod, const char* var, double* val,              const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_GET_VEC) (const char* cli, const char* mod, const char* var, VECTOR3* val,             const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_GET_MX3) (const char* cli, const char* mod, const char* var, MATRIX3* val,             const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_GET_MX4) (const char* cli, const char* mod, const char* var, MATRIX4* val,             const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_GET_OBJ) (const char* cli, const char* mod, const char* var, OBJHANDLE* val,           const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_GET_CST) (const char* cli, const char* mod, const char* var, char* val, size_t *len,   const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_GET_VER) (const char* mod, char* var, size_t* len);
-  typedef bool (*FUNC_MMEXT2_GET_LOG) (char* rFunc, char *rCli, size_t *lCli, char *rMod, size_t *lMod, char *rVar, size_t *lVar, char *rVes, size_t *lVes, bool* rSucc, int* ix,
-                                       const char* cli, const bool skpSelf);
-  typedef bool (*FUNC_MMEXT2_FIND)    (char *rTyp, char *rMod, size_t *lMod, char *rVar, size_t *lVar, OBJHANDLE* rOhv, int* ix,
-                                       const char* cli, const char* mod, const char* var, const OBJHANDLE ohv, const bool skpSelf);
-  typedef bool (*FUNC_MMEXT2_PUT_MMB) (const char* mod, const char* var, const EnjoLib::ModuleMessagingExtBase* val, const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_PUT_MMS) (const char* mod, const char* var, const MMStruct* val, const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_GET_MMB) (const char* cli, const char* mod, const char* var, const EnjoLib::ModuleMessagingExtBase** val, const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_GET_MMS) (const char* cli, const char* mod, const char* var, const MMStruct** val, const OBJHANDLE ohv);
-  typedef bool (*FUNC_MMEXT2_RST_LOG) ();
-  typedef int  (*FUNC_MMEXT2_OBJ_TYP) (const OBJHANDLE& val);
+  struct MMApiShare;
+
+  // Result set from FindAll. Keep one alive across frames and its buffers are reused, so a repeat enumeration
+  // of a similar sized result set does not allocate.
+  class MMFindList {
+  public:
+    MMFindList() : m_n(0) {};
+    size_t Size() const                 { return m_n; }
+    char Typ(const size_t i) const      { return m_recs[i].typ; }
+    const char* Mod(const size_t i) const { return &m_names[m_recs[i].mod]; }
+    const char* Var(const size_t i) const { return &m_names[m_recs[i].var]; }
+    OBJHANDLE Ohv(const size_t i) const { return m_recs[i].ohv; }
+    MMKey Key(const size_t i) const     { return m_recs[i].key; }
+  private:
+    friend class Internal;
+    vector<MMFindRec> m_recs;
+    vector<char> m_names;
+    size_t m_n;
+  };
+
+  // Result of HotKeys, busiest key first. Reused the same way as MMFindList.
+  class MMHotList {
+  public:
+    MMHotList() : m_n(0) {};
+    size_t Size() const                 { return m_n; }
+    const char* Mod(const size_t i) const { return &m_names[m_keys[i].mod]; }
+    const char* Var(const size_t i) const { return &m_names[m_keys[i].var]; }
+    OBJHANDLE Ohv(const size_t i) const { return m_keys[i].ohv; }
+    MMKey Key(const size_t i) const     { return m_keys[i].key; }
+    double Gets(const size_t i) const   { return m_keys[i].gets; }
+    double Puts(const size_t i) const   { return m_keys[i].puts; }
+    double Err(const size_t i) const    { return m_keys[i].err; }
+  private:
+    friend class Internal;
+    vector<MMHotKey> m_keys;
+    vector<char> m_names;
+    size_t m_n;
+  };
 
   class Internal {
   public:
     Internal(const string& mod);
     ~Internal();
     bool IsInit() const {return m_initialized;};
-    bool _Put( const string& var, const int& val,                   const OBJHANDLE ohv = NULL) const   { return ((m_fPI) && ((*m_fPI)(m_mod,          _s(var),    val,  _GetOhv(ohv)))); }
-    bool _Put( const string& var, const bool& val,                  const OBJHANDLE ohv = NULL) const   { return ((m_fPB) && ((*m_fPB)(m_mod,          _s(var),    val,  _GetOhv(ohv)))); }
-    bool _Put( const string& var, const double& val,                const OBJHANDLE ohv = NULL) const   { return ((m_fPD) && ((*m_fPD)(m_mod,          _s(var),    val,  _GetOhv(ohv)))); }
-    bool _Put( const string& var, const VECTOR3& val,               const OBJHANDLE ohv = NULL) const   { return ((m_fPV) && ((*m_fPV)(m_mod,          _s(var),    val,  _GetOhv(ohv)))); }
-    bool _Put( const string& var, const MATRIX3& val,               const OBJHANDLE ohv = NULL) const   { return ((m_fP3) && ((*m_fP3)(m_mod,          _s(var),    val,  _GetOhv(ohv)))); }
-    bool _Put( const string& var, const MATRIX4& val,               const OBJHANDLE ohv = NULL) const   { return ((m_fP4) && ((*m_fP4)(m_mod,          _s(var),    val,  _GetOhv(ohv)))); }
-    bool _Put( const string& var, const OBJHANDLE& val,             const OBJHANDLE ohv = NULL) const   { return ((m_fPO) && ((*m_fPO)(m_mod,          _s(var),    val,  _GetOhv(ohv)))); }
-    bool _Put( const string& var, const string& val,                const OBJHANDLE ohv = NULL) const   { return ((m_fPS) && ((*m_fPS)(m_mod,          _s(var), _s(val), _GetOhv(ohv)))); }
-    bool _Del( const string& var,                                   const OBJHANDLE ohv = NULL) const   { return ((m_fDA) && ((*m_fDA)(m_mod,          _s(var),          _GetOhv(ohv)))); }
-    bool _Get( const string& mod, const string& var, int* val,       const OBJHANDLE ohv = NULL) const   { return ((m_fGI) && ((*m_fGI)(m_mod, _s(mod), _s(var),    val,  _GetOhv(ohv)))); }
-    bool _Get( const string& mod, const string& var, bool* val,      const OBJHANDLE ohv = NULL) const   { return ((m_fGB) && ((*m_fGB)(m_mod, _s(mod), _s(var),    val,  _GetOhv(ohv)))); }
-    bool _Get( const string& mod, const string& var, double* val,    const OBJHANDLE ohv = NULL) const   { return ((m_fGD) && ((*m_fGD)(m_mod, _s(mod), _s(var),    val,  _GetOhv(ohv)))); }
-    bool _Get( const string& mod, const string& var, VECTOR3* val,   const OBJHANDLE ohv = NULL) const   { return ((m_fGV) && ((*m_fGV)(m_mod, _s(mod), _s(var),    val,  _GetOhv(ohv)))); }
-    bool _Get( const string& mod, const string& var, MATRIX3* val,   const OBJHANDLE ohv = NULL) const   { return ((m_fG3) && ((*m_fG3)(m_mod, _s(mod), _s(var),    val,  _GetOhv(ohv)))); }
-    bool _Get( const string& mod, const string& var, MATRIX4* val,   const OBJHANDLE ohv = NULL) const   { return ((m_fG4) && ((*m_fG4)(m_mod, _s(mod), _s(var),    val,  _GetOhv(ohv)))); }
-    bool _Get( const string& mod, const string& var, OBJHANDLE* val, const OBJHANDLE ohv = NULL) const   { return ((m_fGO) && ((*m_fGO)(m_mod, _s(mod), _s(var),    val,  _GetOhv(ohv)))); }
+    bool _Put( const string& var, const int& val,                   const OBJHANDLE ohv = NULL) const   { return ((m_api->fPI) && ((*m_api->fPI)(m_mod,          _s(var),    val,  _GetOhv(ohv)))); }
+    bool _Put( const string& var, const bool& val,                  const OBJHANDLE ohv = NULL) const   { return ((m_api->fPB) && ((*m_api->fPB)(m_mod,          _s(var),    val,  _GetOhv(ohv)))); }
+    bool _Put( const string& var, const double& val,                const OBJHANDLE ohv = NULL) const   { return ((m_api->fPD) && ((*m_api->fPD)(m_mod,          _s(var),    val,  _GetOhv(ohv)))); }
+    bool _Put( const string& var, const VECTOR3& val,               const OBJHANDLE ohv = NULL) const   { return ((m_api->fPV) && ((*m_api->fPV)(m_mod,          _s(var),    val,  _GetOhv(ohv)))); }
+    bool _Put( const string& var, const MATRIX3& val,               const OBJHANDLE ohv = NULL) const   { return ((m_api->fP3) && ((*m_api->fP3)(m_mod,          _s(var),    val,  _GetOhv(ohv)))); }
+    bool _Put( const string& var, const MATRIX4& val,               const OBJHANDLE ohv = NULL) const   { return ((m_api->fP4) && ((*m_api->fP4)(m_mod,          _s(var),    val,  _GetOhv(ohv)))); }
+    bool _Put( const string& var, const OBJHANDLE& val,             const OBJHANDLE ohv = NULL) const   { return ((m_api->fPO) && ((*m_api->fPO)(m_mod,          _s(var),    val,  _GetOhv(ohv)))); }
+    bool _Put( const string& var, const string& val,                const OBJHANDLE ohv = NULL) const   { return ((m_api->fPS) && ((*m_api->fPS)(m_mod,          _s(var), _s(val), _GetOhv(ohv)))); }
+    bool _Put( const string& var, const char* val,                  const OBJHANDLE ohv = NULL) const   { return ((m_api->fPS) && ((*m_api->fPS)(m_mod,          _s(var),    val,  _GetOhv(ohv)))); }
+    bool _Del( const string& var,                                   const OBJHANDLE ohv = NULL) const   { return ((m_api->fDA) && ((*m_api->fDA)(m_mod,          _s(var),          _GetOhv(ohv)))); }
+    bool _Get( const string& mod, const string& var, int* val,       const OBJHANDLE ohv = NULL) const   { return ((m_api->fGI) && ((*m_api->fGI)(m_mod, _s(mod), _s(var),    val,  _GetOhv(ohv)))); }
+    bool _Get( const string& mod, const string& var, bool* val,      const OBJHANDLE ohv = NULL) const   { return ((m_api->fGB) && ((*m_api->fGB)(m_mod, _s(mod), _s(var),    val,  _GetOhv(ohv)))); }
+    bool _Get( const string& mod, const string& var, double* val,    const OBJHANDLE ohv = NULL) const   { return ((m_api->fGD) && ((*m_api->fGD)(m_mod, _s(mod), _s(var),    val,  _GetOhv(ohv)))); }
+    bool _Get( const string& mod, const string& var, VECTOR3* val,   const OBJHANDLE ohv = NULL) const   { return ((m_api->fGV) && ((*m_api->fGV)(m_mod, _s(mod), _s(var),    val,  _GetOhv(ohv)))); }
+    bool _Get( const string& mod, const string& var, MATRIX3* val,   const OBJHANDLE ohv = NULL) const   { return ((m_api->fG3) && ((*m_api->fG3)(m_mod, _s(mod), _s(var),    val,  _GetOhv(ohv)))); }
+    bool _Get( const string& mod, const string& var, MATRIX4* val,   const OBJHANDLE ohv = NULL) const   { return ((m_api->fG4) && ((*m_api->fG4)(m_mod, _s(mod), _s(var),    val,  _GetOhv(ohv)))); }
+    bool _Get( const string& mod, const string& var, OBJHANDLE* val, const OBJHANDLE ohv = NULL) const   { return ((m_api->fGO) && ((*m_api->fGO)(m_mod, _s(mod), _s(var),    val,  _GetOhv(ohv)))); }
     bool _Get( const string& mod, const string& var, string* val,    const OBJHANDLE ohv = NULL) const;
+    bool _Get( const string& mod, const string& var, MMStrView* val, const OBJHANDLE ohv = NULL) const   { return ((m_api->fRN) && ((*m_api->fRN)(m_mod, _s(mod), _s(var), &val->p, &val->n, _GetOhv(ohv)))); }
     bool _GetVer(string* ver) const;
     bool _GetLog(char *rfunc, string *rcli, string *rmod, string *rvar, string *rves, bool *rsucc, int *ix, const bool skipSelf);
-    bool _RstLog() { return ((m_fRL) && (*m_fRL)()); }
+    bool _RstLog() { return ((m_api->fRL) && (*m_api->fRL)()); }
+    bool _SetLogMode(const MMLogMode mode, const unsigned int sample) { return ((m_api->fSL) && (*m_api->fSL)(mode, sample)); }
     bool _Find(char *rTyp, string* rMod, string* rVar, OBJHANDLE* rOhv, int *ix, const string& mod, const string& var, const OBJHANDLE ohv, const bool skipSelf);
+    bool _Find(char *rTyp, string* rMod, string* rVar, OBJHANDLE* rOhv, MMCursor *cur, const string& mod, const string& var, const OBJHANDLE ohv, const bool skipSelf);
+    bool _FindAll(MMFindList* list, const string& mod, const string& var, const OBJHANDLE ohv, const bool skipSelf);
     void _UpdMod(const string& mod);
-    bool _Put(const string& var, const EnjoLib::ModuleMessagingExtBase* val, const OBJHANDLE ohv = NULL) const { return ((m_fPY) && ((*m_fPY)(m_mod, _s(var), val, _GetOhv(ohv)))); }
-    bool _Put(const string& var, const MMStruct* val, const OBJHANDLE ohv = NULL) const { return ((m_fPX) && ((*m_fPX)(m_mod, _s(var), val, _GetOhv(ohv)))); }
-    bool _Get(const string& mod, const string& var, const EnjoLib::ModuleMessagingExtBase** val, const OBJHANDLE ohv = NULL) const { return ((m_fGY) && ((*m_fGY)(m_mod, _s(mod), _s(var), val, _GetOhv(ohv)))); }
-    bool _Get(const string& mod, const string& var, const MMStruct** val, const OBJHANDLE ohv = NULL) const { return ((m_fGX) && ((*m_fGX)(m_mod, _s(mod), _s(var), val, _GetOhv(ohv)))); }
+    bool _Put(const string& var, const EnjoLib::ModuleMessagingExtBase* val, const OBJHANDLE ohv = NULL) const { return ((m_api->fPY) && ((*m_api->fPY)(m_mod, _s(var), val, _GetOhv(ohv)))); }
+    bool _Put(const string& var, const MMStruct* val, const OBJHANDLE ohv = NULL) const { return ((m_api->fPX) && ((*m_api->fPX)(m_mod, _s(var), val, _GetOhv(ohv)))); }
+    bool _Get(const string& mod, const string& var, const EnjoLib::ModuleMessagingExtBase** val, const OBJHANDLE ohv = NULL) const { return ((m_api->fGY) && ((*m_api->fGY)(m_mod, _s(mod), _s(var), val, _GetOhv(ohv)))); }
+    bool _Get(const string& mod, const string& var, const MMStruct** val, const OBJHANDLE ohv = NULL) const { return ((m_api->fGX) && ((*m_api->fGX)(m_mod, _s(mod), _s(var), val, _GetOhv(ohv)))); }
     int _ObjType(const OBJHANDLE& val) const;
+    bool _Resolve(const string& var, MMKey* key,                    const OBJHANDLE ohv = NULL) const   { return _Resolve(string(m_mod), var, key, ohv); }
+    bool _Resolve(const string& mod, const string& var, MMKey* key, const OBJHANDLE ohv = NULL) const   { return ((m_api->fRK) && ((*m_api->fRK)(_s(mod), _s(var), key, _GetOhv(ohv)))); }
+    bool _Put( const MMKey& key, const int& val) const                                                  { return ((m_api->fPIK) && ((*m_api->fPIK)(       key,    val))); }
+    bool _Put( const MMKey& key, const bool& val) const                                                 { return ((m_api->fPBK) && ((*m_api->fPBK)(       key,    val))); }
+    bool _Put( const MMKey& key, const double& val) const                                               { return ((m_api->fPDK) && ((*m_api->fPDK)(       key,    val))); }
+    bool _Put( const MMKey& key, const VECTOR3& val) const                                              { return ((m_api->fPVK) && ((*m_api->fPVK)(       key,    val))); }
+    bool _Put( const MMKey& key, const MATRIX3& val) const                                              { return ((m_api->fP3K) && ((*m_api->fP3K)(       key,    val))); }
+    bool _Put( const MMKey& key, const MATRIX4& val) const                                              { return ((m_api->fP4K) && ((*m_api->fP4K)(       key,    val))); }
+    bool _Put( const MMKey& key, const OBJHANDLE& val) const                                            { return ((m_api->fPOK) && ((*m_api->fPOK)(       key,    val))); }
+    bool _Put( const MMKey& key, const string& val) const                                               { return ((m_api->fPSK) && ((*m_api->fPSK)(       key, _s(val)))); }
+    bool _Put( const MMKey& key, const char* val) const                                                 { return ((m_api->fPSK) && ((*m_api->fPSK)(       key,    val))); }
+    bool _Get( const MMKey& key, int* val) const                                                        { return ((m_api->fGIK) && ((*m_api->fGIK)(m_mod, key,    val))); }
+    bool _Get( const MMKey& key, bool* val) const                                                       { return ((m_api->fGBK) && ((*m_api->fGBK)(m_mod, key,    val))); }
+    bool _Get( const MMKey& key, double* val) const                                                     { return ((m_api->fGDK) && ((*m_api->fGDK)(m_mod, key,    val))); }
+    bool _Get( const MMKey& key, VECTOR3* val) const                                                    { return ((m_api->fGVK) && ((*m_api->fGVK)(m_mod, key,    val))); }
+    bool _Get( const MMKey& key, MATRIX3* val) const                                                    { return ((m_api->fG3K) && ((*m_api->fG3K)(m_mod, key,    val))); }
+    bool _Get( const MMKey& key, MATRIX4* val) const                                                    { return ((m_api->fG4K) && ((*m_api->fG4K)(m_mod, key,    val))); }
+    bool _Get( const MMKey& key, OBJHANDLE* val) const                                                  { return ((m_api->fGOK) && ((*m_api->fGOK)(m_mod, key,    val))); }
+    bool _Get( const MMKey& key, string* val) const;
+    bool _Get( const MMKey& key, MMStrView* val) const                                                  { return ((m_api->fRS) && ((*m_api->fRS)(m_mod, key, &val->p, &val->n, NULL))); }
+    bool _GetIfChanged(const MMKey& key, int* val, unsigned int* gen) const                             { return ((m_api->fCI) && ((*m_api->fCI)(m_mod, key, val, gen))); }
+    bool _GetIfChanged(const MMKey& key, bool* val, unsigned int* gen) const                            { return ((m_api->fCB) && ((*m_api->fCB)(m_mod, key, val, gen))); }
+    bool _GetIfChanged(const MMKey& key, double* val, unsigned int* gen) const                          { return ((m_api->fCD) && ((*m_api->fCD)(m_mod, key, val, gen))); }
+    bool _GetIfChanged(const MMKey& key, VECTOR3* val, unsigned int* gen) const                         { return ((m_api->fCV) && ((*m_api->fCV)(m_mod, key, val, gen))); }
+    bool _GetIfChanged(const MMKey& key, MATRIX3* val, unsigned int* gen) const                         { return ((m_api->fC3) && ((*m_api->fC3)(m_mod, key, val, gen))); }
+    bool _GetIfChanged(const MMKey& key, MATRIX4* val, unsigned int* gen) const                         { return ((m_api->fC4) && ((*m_api->fC4)(m_mod, key, val, gen))); }
+    bool _GetIfChanged(const MMKey& key, OBJHANDLE* val, unsigned int* gen) const                       { return ((m_api->fCO) && ((*m_api->fCO)(m_mod, key, val, gen))); }
+    bool _GetIfChanged(const MMKey& key, string* val, unsigned int* gen) const;
+    bool _GetIfChanged(const MMKey& key, MMStrView* val, unsigned int* gen) const                       { return ((m_api->fRS) && ((*m_api->fRS)(m_mod, key, &val->p, &val->n, gen))); }
+    bool _GetBatch(MMBatchItem* items, const size_t n) const                                            { return ((m_api->fGM) && _BatchOhv(items, n) && ((*m_api->fGM)(m_mod, items, n))); }
+    bool _PutBatch(MMBatchItem* items, const size_t n) const                                            { return ((m_api->fPM) && _BatchOhv(items, n) && ((*m_api->fPM)(m_mod, items, n))); }
+    bool _Subscribe(unsigned int* id, const string& mod, const string& var, const OBJHANDLE ohv, MMNotifyFunc fn, void* ctx,
+                    const MMNotifyMode mode, const bool skipSelf)                                       { *id = 0; return ((m_api->fSB) && ((*m_api->fSB)(id, m_mod, _s(mod), _s(var), ohv, fn, ctx, mode, skipSelf))); }
+    bool _Unsubscribe(const unsigned int id)                                                            { return ((m_api->fUS) && ((*m_api->fUS)(m_mod, id))); }
+    bool _Dispatch()                                                                                    { return ((m_api->fDS) && ((*m_api->fDS)(m_mod))); }
+    bool _VesselEvents(const bool on)                                                                   { return ((m_api->fVE) && ((*m_api->fVE)(m_mod, on))); }
+    bool _VesselDeleted(const OBJHANDLE ohv)                                                            { return ((m_api->fVD) && ((*m_api->fVD)(ohv))); }
+    bool _ObjCacheStats(unsigned long long* hits, unsigned long long* misses) const                     { *hits = *misses = 0; return ((m_api->fOS) && ((*m_api->fOS)(hits, misses))); }
+    void _FocusChanged(const OBJHANDLE ohv)                                                             { m_focus.store(ohv, memory_order_release); }
+    bool _MemStats(size_t* reserved, size_t* used) const                                                { *reserved = *used = 0; return ((m_api->fMS) && ((*m_api->fMS)(reserved, used))); }
+    bool _ResetSession()                                                                                { return ((m_api->fSR) && ((*m_api->fSR)())); }
+    bool _Snapshot(const string& path)                                                                  { return ((m_api->fSN) && ((*m_api->fSN)(path.c_str()))); }
+    bool _Restore(const string& path)                                                                   { return ((m_api->fRE) && ((*m_api->fRE)(path.c_str()))); }
+    bool _RecordStart(const string& path)                                                               { return ((m_api->fRB) && ((*m_api->fRB)(path.c_str()))); }
+    bool _RecordStop()                                                                                  { return ((m_api->fRX) && ((*m_api->fRX)())); }
+    bool _Replay(const string& path)                                                                    { return ((m_api->fRP) && ((*m_api->fRP)(path.c_str()))); }
+    bool _TraceStart(const string& path)                                                                { return ((m_api->fTB) && ((*m_api->fTB)(path.c_str()))); }
+    bool _TraceStop()                                                                                   { return ((m_api->fTX) && ((*m_api->fTX)())); }
+    bool _GetStats(unsigned int* ix, string* cli, const MMStatOp op, MMStats* stats) const;
+    bool _HotKeys(MMHotList* list, const size_t n) const;
+    bool _GetStats(const string& cli, const MMStatOp op, MMStats* stats) const;
     const char* _s(const string& s) const { return s.c_str(); }
   private:
-    FUNC_MMEXT2_PUT_INT m_fPI;
-    FUNC_MMEXT2_PUT_BOO m_fPB;
-    FUNC_MMEXT2_PUT_DBL m_fPD;
-    FUNC_MMEXT2_PUT_VEC m_fPV;
-    FUNC_MMEXT2_PUT_MX3 m_fP3;
-    FUNC_MMEXT2_PUT_MX4 m_fP4;
-    FUNC_MMEXT2_PUT_OBJ m_fPO;
-    FUNC_MMEXT2_PUT_CST m_fPS;
-    FUNC_MMEXT2_GET_INT m_fGI;
-    FUNC_MMEXT2_GET_BOO m_fGB;
-    FUNC_MMEXT2_GET_DBL m_fGD;
-    FUNC_MMEXT2_GET_VEC m_fGV;
-    FUNC_MMEXT2_GET_MX3 m_fG3;
-    FUNC_MMEXT2_GET_MX4 m_fG4;
-    FUNC_MMEXT2_GET_OBJ m_fGO;
-    FUNC_MMEXT2_GET_CST m_fGS;
-    FUNC_MMEXT2_DEL_ANY m_fDA;
-    FUNC_MMEXT2_GET_VER m_fVR; 
-    FUNC_MMEXT2_GET_LOG m_fGL;
-    FUNC_MMEXT2_FIND    m_fFA;
-    FUNC_MMEXT2_PUT_MMB m_fPY;
-    FUNC_MMEXT2_PUT_MMS m_fPX;
-    FUNC_MMEXT2_GET_MMB m_fGY;
-    FUNC_MMEXT2_GET_MMS m_fGX;
-    FUNC_MMEXT2_RST_LOG m_fRL;
-    FUNC_MMEXT2_OBJ_TYP m_fOT;
+    const MMApi* m_api;          // the shared table of DLL entry points (see MMApiShare), never NULL
     bool m_initialized;
-    HMODULE m_hDLL;
     char* m_mod;
+    atomic<OBJHANDLE> m_focus;  // focus vessel, as last given to _FocusChanged (NULL until then)
     const OBJHANDLE _GetOhv(const OBJHANDLE v) const;
+    bool _BatchOhv(MMBatchItem* items, const size_t n) const;
+    static MMApiShare& _Share();
+    static void _Load(HMODULE dll, MMApi* api);
   };
   // End of class definition
 
   // Inline implementation definition
+  // Strings are read in place where the DLL has the borrowed read by name, and copied once into the caller's string.
+  // The 64 byte buffer and second call remain only as the fallback for an older MMExt2.dll.
   inline bool Internal::_Get(const string& mod, const string& var, string* val, const OBJHANDLE ohv) const {
     *val = "";
-    if (!m_fGS) return false;
+    if (m_api->fRN) {
+      const char* p;
+      size_t n;
+      if (!(*m_api->fRN)(m_mod, _s(mod), _s(var), &p, &n, _GetOhv(ohv))) return false;
+      val->assign(p, n);
+      return true;
+    }
+    if (!m_api->fGS) return false;
     const size_t mxln = 64;
     size_t csl = mxln;
     char buf[mxln];
-    if (!(*m_fGS)(m_mod, _s(mod), _s(var), buf, &csl, _GetOhv(ohv))) return false;
+    if (!(*m_api->fGS)(m_mod, _s(mod), _s(var), buf, &csl, _GetOhv(ohv))) return false;
     if (csl <= mxln) {
       *val = buf;
       return true;
@@ -134,20 +191,43 @@ namespace MMExt2
     // long string support
     char *p1 = static_cast<char *>(malloc(csl));
     if (p1 == NULL) return false;
-    if (!(*m_fGS)(m_mod, _s(mod), _s(var), p1, &csl, _GetOhv(ohv))) return false;
+    if (!(*m_api->fGS)(m_mod, _s(mod), _s(var), p1, &csl, _GetOhv(ohv))) return false;
     *val = p1;
     free(p1);
     return true;
   };
 
 
+  inline bool Internal::_Get(const MMKey& key, string* val) const {
+    MMStrView v;
+    if (!_Get(key, &v)) {
+      *val = "";
+      return false;
+    }
+    val->assign(v.p, v.n);
+    return true;
+  };
+
+  inline bool Internal::_GetIfChanged(const MMKey& key, string* val, unsigned int* gen) const {
+    MMStrView v;
+    if (!_GetIfChanged(key, &v, gen)) return false;
+    val->assign(v.p, v.n);
+    return true;
+  };
+
   inline bool Internal::_GetVer(string* ver) const {
     *ver = "";
-    if (!m_fVR) return false;
+    const char* p;
+    if (m_api->fRV) {
+      if (!(*m_api->fRV)(m_mod, &p)) return false;
+      *ver = p;
+      return true;
+    }
+    if (!m_api->fVR) return false;
     const size_t mxln = 64;
     size_t csl = mxln;
     char buf[mxln];
-    if (!(*m_fVR)(m_mod, buf, &csl)) return false;
+    if (!(*m_api->fVR)(m_mod, buf, &csl)) return false;
     if (csl <= mxln) {
         *ver = buf;
         return true;
@@ -155,7 +235,7 @@ namespace MMExt2
     // long string support
     char *p1 = static_cast<char *>(malloc(csl));
     if (p1 == NULL) return false;
-    if (!(*m_fVR)(m_mod, p1, &csl)) return false;
+    if (!(*m_api->fVR)(m_mod, p1, &csl)) return false;
     *ver = p1;
     free(p1);
     return true;
@@ -165,7 +245,7 @@ namespace MMExt2
     *rMod = "";
     *rVar = "";
     *rOhv = NULL;
-    if (!m_fFA) return false;
+    if (!m_api->fFA) return false;
     const size_t mxln = 64;
     size_t lmod = mxln, lvar = mxln;
     bool needBig;
@@ -176,14 +256,14 @@ namespace MMExt2
     pmod = bmod;
     pvar = bvar;
 
-    if (!(*m_fFA)(rTyp, pmod, &lmod, pvar, &lvar, rOhv, ix,  m_mod, _s(mod), _s(var), ohv, skipSelf)) return false;
+    if (!(*m_api->fFA)(rTyp, pmod, &lmod, pvar, &lvar, rOhv, ix,  m_mod, _s(mod), _s(var), ohv, skipSelf)) return false;
     if (lmod > mxln || lvar > mxln) {
       needBig = true;
       pmod = static_cast<char *>(malloc(lmod));
       if (pmod == NULL) return false;
       pvar = static_cast<char *>(malloc(lvar));
       if (pvar == NULL) { free(pmod);  return false; }
-      if (!(*m_fFA)(rTyp, pmod, &lmod, pvar, &lvar, rOhv, ix, m_mod, _s(mod), _s(var), ohv, skipSelf)) {
+      if (!(*m_api->fFA)(rTyp, pmod, &lmod, pvar, &lvar, rOhv, ix, m_mod, _s(mod), _s(var), ohv, skipSelf)) {
         free(pmod);
         free(pvar);
         return false;
@@ -199,15 +279,91 @@ namespace MMExt2
     return true;
   }
 
+  inline bool Internal::_Find(char *rTyp, string* rMod, string* rVar, OBJHANDLE* rOhv, MMCursor *cur, const string& mod, const string& var, const OBJHANDLE ohv, const bool skipSelf) {
+    *rMod = "";
+    *rVar = "";
+    *rOhv = NULL;
+    const char *pmod, *pvar;
+    if (!m_api->fRF || !(*m_api->fRF)(rTyp, &pmod, &pvar, rOhv, cur, m_mod, _s(mod), _s(var), ohv, skipSelf)) return false;
+    *rMod = pmod;
+    *rVar = pvar;
+    return true;
+  }
+
+  inline bool Internal::_FindAll(MMFindList* list, const string& mod, const string& var, const OBJHANDLE ohv, const bool skipSelf) {
+    list->m_n = 0;
+    if (!m_api->fFL) return false;
+    if (list->m_recs.empty()) {
+      list->m_recs.resize(64);
+      list->m_names.resize(2048);
+    }
+    size_t nRec = list->m_recs.size(), lNames = list->m_names.size();
+    if (!(*m_api->fFL)(&list->m_recs[0], &nRec, &list->m_names[0], &lNames, m_mod, _s(mod), _s(var), ohv, skipSelf)) return false;
+    if (nRec > list->m_recs.size() || lNames > list->m_names.size()) {
+      // grow to the reported size, with some headroom for next time, and ask again
+      list->m_recs.resize(nRec + nRec / 2 + 1);
+      list->m_names.resize(lNames + lNames / 2 + 1);
+      nRec = list->m_recs.size();
+      lNames = list->m_names.size();
+      if (!(*m_api->fFL)(&list->m_recs[0], &nRec, &list->m_names[0], &lNames, m_mod, _s(mod), _s(var), ohv, skipSelf)) return false;
+      if (nRec > list->m_recs.size() || lNames > list->m_names.size()) return false;
+    }
+    list->m_n = nRec;
+    return true;
+  }
+
+  inline bool Internal::_HotKeys(MMHotList* list, const size_t n) const {
+    list->m_n = 0;
+    if (!m_api->fHK || !n) return false;
+    if (list->m_keys.size() < n) list->m_keys.resize(n);
+    if (list->m_names.empty()) list->m_names.resize(n * 32);
+    size_t nKeys = n, lNames = list->m_names.size();
+    if (!(*m_api->fHK)(&list->m_keys[0], &nKeys, &list->m_names[0], &lNames)) return false;
+    if (lNames > list->m_names.size()) {
+      list->m_names.resize(lNames + lNames / 2 + 1);
+      nKeys = n;
+      lNames = list->m_names.size();
+      if (!(*m_api->fHK)(&list->m_keys[0], &nKeys, &list->m_names[0], &lNames)) return false;
+      if (lNames > list->m_names.size()) return false;
+    }
+    list->m_n = nKeys;
+    return true;
+  }
+
+  inline bool Internal::_GetStats(unsigned int* ix, string* cli, const MMStatOp op, MMStats* stats) const {
+    const char* c;
+    if (!m_api->fST || !(*m_api->fST)(*ix, &c, op, stats)) return false;
+    *cli = c;
+    (*ix)++;
+    return true;
+  }
+
+  inline bool Internal::_GetStats(const string& cli, const MMStatOp op, MMStats* stats) const {
+    const char* c;
+    if (!m_api->fST) return false;
+    for (unsigned int ix = 0; (*m_api->fST)(ix, &c, op, stats); ix++) {
+      if (cli == c) return true;
+    }
+    return false;
+  }
 
   inline bool Internal::_GetLog(char *rfunc, string *rcli, string *rmod, string *rvar, string *rves, bool *rsucc, int *ix, const bool skipSelf) {
-    if (!m_fGL) return false;
+    if (m_api->fRG) {
+      const char *c, *m, *v, *s;
+      if (!(*m_api->fRG)(rfunc, &c, &m, &v, &s, rsucc, ix, m_mod, skipSelf)) return false;
+      *rcli = c;
+      *rmod = m;
+      *rvar = v;
+      *rves = s;
+      return true;
+    }
+    if (!m_api->fGL) return false;
     bool needBig = false;
     const size_t mxln = 64;
     size_t lcli = mxln, lmod = mxln, lvar = mxln, lves = mxln;
     char cli[mxln], mod[mxln], var[mxln], ves[mxln];
     char *pcli = cli, *pmod = mod, *pvar = var, *pves = ves;
-    if (!(*m_fGL)(rfunc, pcli, &lcli, pmod, &lmod, pvar, &lvar, pves, &lves, rsucc, ix, m_mod, skipSelf)) return false;
+    if (!(*m_api->fGL)(rfunc, pcli, &lcli, pmod, &lmod, pvar, &lvar, pves, &lves, rsucc, ix, m_mod, skipSelf)) return false;
     if (lcli > mxln || lmod > mxln || lvar > mxln || lves > mxln) {
         needBig = true;
         pcli = static_cast<char *>(malloc(lcli));
@@ -218,7 +374,7 @@ namespace MMExt2
         if (pvar == NULL) { free(pmod);  free(pcli);  return false; }
         pves = static_cast<char *>(malloc(lves));
         if (pves == NULL) { free(pvar);  free(pmod);  free(pcli);  return false; }
-        if (!(*m_fGL)(rfunc, pcli, &lcli, pmod, &lmod, pvar, &lvar, pves, &lves, rsucc, ix, m_mod, skipSelf)) {
+        if (!(*m_api->fGL)(rfunc, pcli, &lcli, pmod, &lmod, pvar, &lvar, pves, &lves, rsucc, ix, m_mod, skipSelf)) {
             free(pcli); free(pmod); free(pvar); free(pves);
             return false;
         }
@@ -233,9 +389,23 @@ namespace MMExt2
     return true;
   }
 
+  // The default vessel is the focus vessel: one atomic load, once the client forwards its clbkFocusChanged calls to
+  // _FocusChanged, and otherwise asked of Orbiter on each call
   inline const OBJHANDLE Internal::_GetOhv(const OBJHANDLE ohv) const {
       if (ohv) return ohv;
-      return oapiGetFocusInterface()->GetHandle();
+      OBJHANDLE focus = m_focus.load(memory_order_acquire);
+      return (focus ? focus : oapiGetFocusInterface()->GetHandle());
+  }
+
+  // Items still to be resolved by name default to the focus vessel, as for the single Put and Get
+  inline bool Internal::_BatchOhv(MMBatchItem* items, const size_t n) const {
+      OBJHANDLE focus = NULL;
+      for (size_t i = 0; i < n; i++) {
+          if (items[i].key.IsValid() || items[i].ohv) continue;
+          if (!focus) focus = _GetOhv(NULL);
+          items[i].ohv = focus;
+      }
+      return true;
   }
 
   inline void Internal::_UpdMod(const string& mod) {
@@ -247,52 +417,137 @@ namespace MMExt2
   }
 
   inline int Internal::_ObjType(const OBJHANDLE& val) const {
-    if (!m_fOT) return -1;
-    return ((*m_fOT)(val));
+    if (!m_api->fOT) return -1;
+    return ((*m_api->fOT)(val));
+  }
+
+  // Every Internal in a module shares one table of entry points, counted, so MMExt2.dll is loaded and the table looked
+  // up only once; an Internal made while the DLL is not loaded tries the load again. The table is MMExt2.dll's own,
+  // from ModMsgGetApi_v2; an older DLL without that export has one filled in here with GetProcAddress. With no DLL at
+  // all, every entry is NULL.
+  struct MMApiShare {
+    MMApiShare() : refs(0), dll(NULL), api(&none), own(), none() {};
+    mutex lock;
+    unsigned int refs;
+    HMODULE dll;
+    const MMApi* api;
+    MMApi own;
+    MMApi none;
+  };
+
+  inline MMApiShare& Internal::_Share() {
+    static MMApiShare share;
+    return share;
+  }
+
+  inline void Internal::_Load(HMODULE dll, MMApi* api) {
+    api->fPI = (FUNC_MMEXT2_PUT_INT)GetProcAddress(dll, "ModMsgPut_int_v1");
+    api->fPB = (FUNC_MMEXT2_PUT_BOO)GetProcAddress(dll, "ModMsgPut_bool_v1");
+    api->fPD = (FUNC_MMEXT2_PUT_DBL)GetProcAddress(dll, "ModMsgPut_double_v1");
+    api->fPV = (FUNC_MMEXT2_PUT_VEC)GetProcAddress(dll, "ModMsgPut_VECTOR3_v1");
+    api->fP3 = (FUNC_MMEXT2_PUT_MX3)GetProcAddress(dll, "ModMsgPut_MATRIX3_v1");
+    api->fP4 = (FUNC_MMEXT2_PUT_MX4)GetProcAddress(dll, "ModMsgPut_MATRIX4_v1");
+    api->fPO = (FUNC_MMEXT2_PUT_OBJ)GetProcAddress(dll, "ModMsgPut_OBJHANDLE_v1");
+    api->fPS = (FUNC_MMEXT2_PUT_CST)GetProcAddress(dll, "ModMsgPut_c_str_v1");
+    api->fGI = (FUNC_MMEXT2_GET_INT)GetProcAddress(dll, "ModMsgGet_int_v1");
+    api->fGB = (FUNC_MMEXT2_GET_BOO)GetProcAddress(dll, "ModMsgGet_bool_v1");
+    api->fGD = (FUNC_MMEXT2_GET_DBL)GetProcAddress(dll, "ModMsgGet_double_v1");
+    api->fGV = (FUNC_MMEXT2_GET_VEC)GetProcAddress(dll, "ModMsgGet_VECTOR3_v1");
+    api->fG3 = (FUNC_MMEXT2_GET_MX3)GetProcAddress(dll, "ModMsgGet_MATRIX3_v1");
+    api->fG4 = (FUNC_MMEXT2_GET_MX4)GetProcAddress(dll, "ModMsgGet_MATRIX4_v1");
+    api->fGO = (FUNC_MMEXT2_GET_OBJ)GetProcAddress(dll, "ModMsgGet_OBJHANDLE_v1");
+    api->fGS = (FUNC_MMEXT2_GET_CST)GetProcAddress(dll, "ModMsgGet_c_str_v1");
+    api->fDA = (FUNC_MMEXT2_DEL_ANY)GetProcAddress(dll, "ModMsgDel_any_v1");
+    api->fVR = (FUNC_MMEXT2_GET_VER)GetProcAddress(dll, "ModMsgGet_ver_v1");
+    api->fGL = (FUNC_MMEXT2_GET_LOG)GetProcAddress(dll, "ModMsgGet_log_v1");
+    api->fFA = (FUNC_MMEXT2_FIND)GetProcAddress(dll, "ModMsgFind_v1");
+    //api->fPY = (FUNC_MMEXT2_PUT_MMB)GetProcAddress(dll, "ModMsgPut_MMBase_v1");
+    api->fPX = (FUNC_MMEXT2_PUT_MMS)GetProcAddress(dll, "ModMsgPut_MMStruct_v1");
+    //api->fGY = (FUNC_MMEXT2_GET_MMB)GetProcAddress(dll, "ModMsgGet_MMBase_v1");
+    api->fGX = (FUNC_MMEXT2_GET_MMS)GetProcAddress(dll, "ModMsgGet_MMStruct_v1");
+    api->fRL = (FUNC_MMEXT2_RST_LOG)GetProcAddress(dll, "ModMsgRst_log_v1");
+    api->fOT = (FUNC_MMEXT2_OBJ_TYP)GetProcAddress(dll, "ModMsgObj_typ_v1");
+    api->fRK = (FUNC_MMEXT2_RESOLVE)GetProcAddress(dll, "ModMsgResolve_v2");
+    api->fPIK = (FUNC_MMEXT2_PUT_INT_KEY)GetProcAddress(dll, "ModMsgPut_int_v2");
+    api->fPBK = (FUNC_MMEXT2_PUT_BOO_KEY)GetProcAddress(dll, "ModMsgPut_bool_v2");
+    api->fPDK = (FUNC_MMEXT2_PUT_DBL_KEY)GetProcAddress(dll, "ModMsgPut_double_v2");
+    api->fPVK = (FUNC_MMEXT2_PUT_VEC_KEY)GetProcAddress(dll, "ModMsgPut_VECTOR3_v2");
+    api->fP3K = (FUNC_MMEXT2_PUT_MX3_KEY)GetProcAddress(dll, "ModMsgPut_MATRIX3_v2");
+    api->fP4K = (FUNC_MMEXT2_PUT_MX4_KEY)GetProcAddress(dll, "ModMsgPut_MATRIX4_v2");
+    api->fPOK = (FUNC_MMEXT2_PUT_OBJ_KEY)GetProcAddress(dll, "ModMsgPut_OBJHANDLE_v2");
+    api->fPSK = (FUNC_MMEXT2_PUT_CST_KEY)GetProcAddress(dll, "ModMsgPut_c_str_v2");
+    api->fGIK = (FUNC_MMEXT2_GET_INT_KEY)GetProcAddress(dll, "ModMsgGet_int_v2");
+    api->fGBK = (FUNC_MMEXT2_GET_BOO_KEY)GetProcAddress(dll, "ModMsgGet_bool_v2");
+    api->fGDK = (FUNC_MMEXT2_GET_DBL_KEY)GetProcAddress(dll, "ModMsgGet_double_v2");
+    api->fGVK = (FUNC_MMEXT2_GET_VEC_KEY)GetProcAddress(dll, "ModMsgGet_VECTOR3_v2");
+    api->fG3K = (FUNC_MMEXT2_GET_MX3_KEY)GetProcAddress(dll, "ModMsgGet_MATRIX3_v2");
+    api->fG4K = (FUNC_MMEXT2_GET_MX4_KEY)GetProcAddress(dll, "ModMsgGet_MATRIX4_v2");
+    api->fGOK = (FUNC_MMEXT2_GET_OBJ_KEY)GetProcAddress(dll, "ModMsgGet_OBJHANDLE_v2");
+    api->fGSK = (FUNC_MMEXT2_GET_CST_KEY)GetProcAddress(dll, "ModMsgGet_c_str_v2");
+    api->fSL = (FUNC_MMEXT2_SET_LOG)GetProcAddress(dll, "ModMsgSetLogMode_v2");
+    api->fFC = (FUNC_MMEXT2_FIND_CUR)GetProcAddress(dll, "ModMsgFind_v2");
+    api->fFL = (FUNC_MMEXT2_FIND_ALL)GetProcAddress(dll, "ModMsgFindAll_v2");
+    api->fGM = (FUNC_MMEXT2_GET_BAT)GetProcAddress(dll, "ModMsgGetBatch_v2");
+    api->fPM = (FUNC_MMEXT2_PUT_BAT)GetProcAddress(dll, "ModMsgPutBatch_v2");
+    api->fSB = (FUNC_MMEXT2_SUBSCRIBE)GetProcAddress(dll, "ModMsgSubscribe_v2");
+    api->fUS = (FUNC_MMEXT2_UNSUBSCRIBE)GetProcAddress(dll, "ModMsgUnsubscribe_v2");
+    api->fDS = (FUNC_MMEXT2_DISPATCH)GetProcAddress(dll, "ModMsgDispatch_v2");
+    api->fVE = (FUNC_MMEXT2_VES_EVT)GetProcAddress(dll, "ModMsgVesselEvents_v2");
+    api->fVD = (FUNC_MMEXT2_VES_DEL)GetProcAddress(dll, "ModMsgVesselDeleted_v2");
+    api->fOS = (FUNC_MMEXT2_OBJ_STA)GetProcAddress(dll, "ModMsgObjCacheStats_v2");
+    api->fCI = (FUNC_MMEXT2_CHG_INT)GetProcAddress(dll, "ModMsgGetIfChanged_int_v2");
+    api->fCB = (FUNC_MMEXT2_CHG_BOO)GetProcAddress(dll, "ModMsgGetIfChanged_bool_v2");
+    api->fCD = (FUNC_MMEXT2_CHG_DBL)GetProcAddress(dll, "ModMsgGetIfChanged_double_v2");
+    api->fCV = (FUNC_MMEXT2_CHG_VEC)GetProcAddress(dll, "ModMsgGetIfChanged_VECTOR3_v2");
+    api->fC3 = (FUNC_MMEXT2_CHG_MX3)GetProcAddress(dll, "ModMsgGetIfChanged_MATRIX3_v2");
+    api->fC4 = (FUNC_MMEXT2_CHG_MX4)GetProcAddress(dll, "ModMsgGetIfChanged_MATRIX4_v2");
+    api->fCO = (FUNC_MMEXT2_CHG_OBJ)GetProcAddress(dll, "ModMsgGetIfChanged_OBJHANDLE_v2");
+    api->fCS = (FUNC_MMEXT2_CHG_CST)GetProcAddress(dll, "ModMsgGetIfChanged_c_str_v2");
+    api->fRS = (FUNC_MMEXT2_REF_CST)GetProcAddress(dll, "ModMsgGetRef_c_str_v2");
+    api->fRV = (FUNC_MMEXT2_REF_VER)GetProcAddress(dll, "ModMsgGetVerRef_v2");
+    api->fRG = (FUNC_MMEXT2_REF_LOG)GetProcAddress(dll, "ModMsgGetLogRef_v2");
+    api->fRF = (FUNC_MMEXT2_REF_FIND)GetProcAddress(dll, "ModMsgFindRef_v2");
+    api->fMS = (FUNC_MMEXT2_MEM_STA)GetProcAddress(dll, "ModMsgMemStats_v2");
+    api->fSR = (FUNC_MMEXT2_RST_SES)GetProcAddress(dll, "ModMsgResetSession_v2");
+    api->fSN = (FUNC_MMEXT2_SNAP)GetProcAddress(dll, "ModMsgSnapshot_v2");
+    api->fRE = (FUNC_MMEXT2_RESTORE)GetProcAddress(dll, "ModMsgRestore_v2");
+    api->fRB = (FUNC_MMEXT2_REC_BEG)GetProcAddress(dll, "ModMsgRecordStart_v2");
+    api->fRX = (FUNC_MMEXT2_REC_STP)GetProcAddress(dll, "ModMsgRecordStop_v2");
+    api->fRP = (FUNC_MMEXT2_REPLAY)GetProcAddress(dll, "ModMsgReplay_v2");
+    api->fTB = (FUNC_MMEXT2_TRC_BEG)GetProcAddress(dll, "ModMsgTraceStart_v2");
+    api->fTX = (FUNC_MMEXT2_TRC_STP)GetProcAddress(dll, "ModMsgTraceStop_v2");
+    api->fST = (FUNC_MMEXT2_STATS)GetProcAddress(dll, "ModMsgGetStats_v2");
+    api->fHK = (FUNC_MMEXT2_HOT_KEYS)GetProcAddress(dll, "ModMsgHotKeys_v2");
+    api->fRN = (FUNC_MMEXT2_REF_CST_NAME)GetProcAddress(dll, "ModMsgGetRefByName_c_str_v2");
   }
 
   inline Internal::Internal(const string& mod) :
-    m_initialized(false),
-    m_hDLL(NULL), m_fPI(NULL), m_fPB(NULL), m_fPD(NULL), m_fPV(NULL),
-    m_fP3(NULL),  m_fP4(NULL), m_fPO(NULL), m_fPS(NULL), m_fGI(NULL),
-    m_fGB(NULL),  m_fGD(NULL), m_fGV(NULL), m_fG3(NULL), m_fG4(NULL),
-    m_fGO(NULL),  m_fGS(NULL), m_fDA(NULL), m_fVR(NULL), m_fGL(NULL),
-    m_fFA(NULL),  m_fPY(NULL), m_fPX(NULL), m_fGY(NULL), m_fGX(NULL),
-    m_fRL(NULL),  m_fOT(NULL)    {
-    if (m_initialized) return;
+    m_api(NULL), m_initialized(false), m_focus(NULL) {
     m_mod = _strdup(mod.c_str());
-    if (!(m_hDLL = LoadLibraryA(".\\Modules\\MMExt2.dll"))) return;
-    m_fPI = (FUNC_MMEXT2_PUT_INT)GetProcAddress(m_hDLL, "ModMsgPut_int_v1");
-    m_fPB = (FUNC_MMEXT2_PUT_BOO)GetProcAddress(m_hDLL, "ModMsgPut_bool_v1");
-    m_fPD = (FUNC_MMEXT2_PUT_DBL)GetProcAddress(m_hDLL, "ModMsgPut_double_v1");
-    m_fPV = (FUNC_MMEXT2_PUT_VEC)GetProcAddress(m_hDLL, "ModMsgPut_VECTOR3_v1");
-    m_fP3 = (FUNC_MMEXT2_PUT_MX3)GetProcAddress(m_hDLL, "ModMsgPut_MATRIX3_v1");
-    m_fP4 = (FUNC_MMEXT2_PUT_MX4)GetProcAddress(m_hDLL, "ModMsgPut_MATRIX4_v1");
-    m_fPO = (FUNC_MMEXT2_PUT_OBJ)GetProcAddress(m_hDLL, "ModMsgPut_OBJHANDLE_v1");
-    m_fPS = (FUNC_MMEXT2_PUT_CST)GetProcAddress(m_hDLL, "ModMsgPut_c_str_v1");
-    m_fGI = (FUNC_MMEXT2_GET_INT)GetProcAddress(m_hDLL, "ModMsgGet_int_v1");
-    m_fGB = (FUNC_MMEXT2_GET_BOO)GetProcAddress(m_hDLL, "ModMsgGet_bool_v1");
-    m_fGD = (FUNC_MMEXT2_GET_DBL)GetProcAddress(m_hDLL, "ModMsgGet_double_v1");
-    m_fGV = (FUNC_MMEXT2_GET_VEC)GetProcAddress(m_hDLL, "ModMsgGet_VECTOR3_v1");
-    m_fG3 = (FUNC_MMEXT2_GET_MX3)GetProcAddress(m_hDLL, "ModMsgGet_MATRIX3_v1");
-    m_fG4 = (FUNC_MMEXT2_GET_MX4)GetProcAddress(m_hDLL, "ModMsgGet_MATRIX4_v1");
-    m_fGO = (FUNC_MMEXT2_GET_OBJ)GetProcAddress(m_hDLL, "ModMsgGet_OBJHANDLE_v1");
-    m_fGS = (FUNC_MMEXT2_GET_CST)GetProcAddress(m_hDLL, "ModMsgGet_c_str_v1");
-    m_fDA = (FUNC_MMEXT2_DEL_ANY)GetProcAddress(m_hDLL, "ModMsgDel_any_v1");
-    m_fVR = (FUNC_MMEXT2_GET_VER)GetProcAddress(m_hDLL, "ModMsgGet_ver_v1");
-    m_fGL = (FUNC_MMEXT2_GET_LOG)GetProcAddress(m_hDLL, "ModMsgGet_log_v1");
-    m_fFA = (FUNC_MMEXT2_FIND)   GetProcAddress(m_hDLL, "ModMsgFind_v1");
-    //m_fPY = (FUNC_MMEXT2_PUT_MMB)GetProcAddress(m_hDLL, "ModMsgPut_MMBase_v1");
-    m_fPX = (FUNC_MMEXT2_PUT_MMS)GetProcAddress(m_hDLL, "ModMsgPut_MMStruct_v1");
-    //m_fGY = (FUNC_MMEXT2_GET_MMB)GetProcAddress(m_hDLL, "ModMsgGet_MMBase_v1");
-    m_fGX = (FUNC_MMEXT2_GET_MMS)GetProcAddress(m_hDLL, "ModMsgGet_MMStruct_v1");
-    m_fRL = (FUNC_MMEXT2_RST_LOG)GetProcAddress(m_hDLL, "ModMsgRst_log_v1");
-    m_fOT = (FUNC_MMEXT2_OBJ_TYP)GetProcAddress(m_hDLL, "ModMsgObj_typ_v1");
-    m_initialized = true;
+    MMApiShare& share = _Share();
+    lock_guard<mutex> lk(share.lock);
+    share.refs++;
+    if (!share.dll && (share.dll = LoadLibraryA(".\\Modules\\MMExt2.dll"))) {
+      FUNC_MMEXT2_GET_API fGA = (FUNC_MMEXT2_GET_API)GetProcAddress(share.dll, "ModMsgGetApi_v2");
+      if (!fGA || !(share.api = (*fGA)(MMEXT2_API_VERSION))) {
+        _Load(share.dll, &share.own);
+        share.api = &share.own;
+      }
+    }
+    m_api = share.api;
+    m_initialized = (share.dll != NULL);
   };
 
   inline Internal::~Internal() {
-    if (m_hDLL) FreeLibrary(m_hDLL);
+    MMApiShare& share = _Share();
+    {
+      lock_guard<mutex> lk(share.lock);
+      if (--share.refs == 0 && share.dll) {
+        FreeLibrary(share.dll);
+        share.dll = NULL;
+        share.api = &share.none;
+      }
+    }
     if (m_mod) free(m_mod);
   };
   // End of inline implementation definition
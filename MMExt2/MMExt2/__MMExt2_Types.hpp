@@ -0,0 +1,153 @@
+// =======================================================================
+//         ORBITER AUX LIBRARY: Module Messaging Extended v2a
+//                              DLL Interface shared types header
+//
+// Copyright  (C) 2014-2018 Szymon "Enjo" Ender and Andrew "ADSWNJ" Stokes
+//                         All rights reserved
+//
+// See MMExt2_Advanced.hpp for license and usage information.
+// This is an internal implementation file. Do not include this directly
+// in your code. To use, refer to the documentation in the Orbitersdk\Doc
+// folder.
+// =======================================================================
+#pragma once
+#ifndef MMExt2_Types_H
+#define MMExt2_Types_H
+namespace MMExt2
+{
+  // Compact handle for a (module, variable, vessel) key, resolved once via Resolve() and then
+  // passed to the key-based Put and Get calls. A default-constructed key is invalid.
+  struct MMKey {
+  public:
+    MMKey() : h(0) {};
+    bool IsValid() const { return h != 0; }
+    unsigned int h;
+  };
+
+  // Read-only view of a string value held in the core: Get or GetIfChanged into an MMStrView instead of a string, and
+  // nothing is copied or allocated. The characters stay valid until that key's next Put or Delete, so use the view in
+  // the same frame step, and take a copy (string(v.Data(), v.Size())) of anything you want to keep.
+  struct MMStrView {
+  public:
+    MMStrView() : p(""), n(0) {};
+    const char* Data() const { return p; }  // NUL-terminated
+    size_t Size() const { return n; }
+    bool Empty() const { return n == 0; }
+    const char* p;
+    size_t n;
+  };
+
+  // Find position. Start each enumeration with a default-constructed cursor and pass it back unchanged with the
+  // same query to step through the matches. The fields are private to the core.
+  struct MMCursor {
+  public:
+    MMCursor() : pos(0), last(0) {};
+    MMKey Key() const { MMKey k; k.h = last; return k; }  // key of the last match returned
+    unsigned int pos;
+    unsigned int last;
+  };
+
+  // One FindAll match. mod and var are byte offsets of NUL-terminated names in the caller's name buffer.
+  // (Include orbitersdk.h before this header for OBJHANDLE.)
+  struct MMFindRec {
+    char typ;
+    OBJHANDLE ohv;
+    MMKey key;
+    unsigned int mod;
+    unsigned int var;
+  };
+
+  // One HotKeys entry: a key's Get and Put calls per sim second, since the last ResetSession. Rates are estimated from
+  // sampled calls. gets and puts are what was counted while the key was being tracked, so the key's true call rate is
+  // between gets + puts and gets + puts + err. mod and var are byte offsets as for MMFindRec.
+  struct MMHotKey {
+    OBJHANDLE ohv;
+    MMKey key;
+    unsigned int mod;
+    unsigned int var;
+    double gets;
+    double puts;
+    double err;
+  };
+
+  // One item for GetBatch / PutBatch. Give either a resolved key, or var (plus mod for a Get) and ohv. A key resolved
+  // from the names is written back, so the same item array reused next frame skips the name lookup. A Get only looks
+  // the names up, so one for a key nothing has Put fails, and is tried again by name next time.
+  // typ is one of the fixed size type chars: 'b', 'i', 'd', 'v', '3', '4', 'o'. val points to a value of that type,
+  // the destination for a Get or the source for a Put. ok is set per item.
+  struct MMBatchItem {
+  public:
+    MMBatchItem() : mod(NULL), var(NULL), ohv(NULL), typ('\0'), val(NULL), ok(false) {};
+    MMKey key;
+    const char* mod;
+    const char* var;
+    OBJHANDLE ohv;
+    char typ;
+    void* val;
+    bool ok;
+  };
+
+  // Activity log modes for SetLogMode(). MMLOG_FIRST (log each distinct action once) is the default.
+  enum MMLogMode {
+    MMLOG_OFF = 0,      // no logging at all, GetLog returns nothing new
+    MMLOG_FIRST = 1,    // first occurrence of each client / action / result / key
+    MMLOG_SAMPLED = 2,  // one in every N calls, duplicates included
+    MMLOG_FULL = 3      // every call, duplicates included
+  };
+
+  // Change callback for Subscribe(). typ is the key's new type char, or '\0' when its value has been deleted. mod and
+  // var point into the core and stay valid while MMExt2.dll is loaded. ctx is passed back unchanged.
+  typedef void (*MMNotifyFunc)(const char* mod, const char* var, OBJHANDLE ohv, MMKey key, char typ, void* ctx);
+
+  // Delivery modes for Subscribe()
+  enum MMNotifyMode {
+    MMNOTIFY_SYNC = 0,  // called straight from inside the Put (on the putting thread), once per change
+    MMNOTIFY_FRAME = 1  // coalesced per key, and delivered from your own Dispatch() call, e.g. once per clbkPreStep
+  };
+
+  // Operations counted by GetStats. Puts count against the module written to, everything else against the caller.
+  enum MMStatOp {
+    MMSTAT_PUT = 0,
+    MMSTAT_GET = 1,     // every Get form, GetIfChanged and GetMany items included
+    MMSTAT_DELETE = 2,
+    MMSTAT_FIND = 3,    // one per Find step, or per FindAll
+    MMSTAT_LOG = 4,     // one per GetLog record read
+    MMSTAT_OPS = 5
+  };
+  const unsigned int MMSTAT_BUCKETS = 272;
+
+  // One client's counts for one operation, since MMExt2.dll was loaded. A miss is a call that returned false (for
+  // GetIfChanged, that includes an unchanged value). bytes counts the values copied in or out, and FindAll names.
+  // One call in 8 per thread is timed into hist, a log-linear latency histogram in ns: bucket b < 16 holds exactly
+  // b ns, and each power of two above that is split into 8 buckets, so any bucket is within 12.5% of its values.
+  struct MMStats {
+  public:
+    MMStats() : calls(0), misses(0), bytes(0), timed(0) { for (unsigned int b = 0; b < MMSTAT_BUCKETS; b++) hist[b] = 0; };
+    static unsigned int Bucket(unsigned long long ns) {
+      if (ns < 16) return static_cast<unsigned int>(ns);
+      unsigned int e = 4;
+      while (e < 35 && (ns >> (e + 1))) e++;
+      if (ns >> (e + 1)) return MMSTAT_BUCKETS - 1;
+      return 16 + (e - 4) * 8 + static_cast<unsigned int>((ns >> (e - 3)) - 8);
+    }
+    static unsigned long long BucketLow(unsigned int b) {
+      if (b < 16) return b;
+      return static_cast<unsigned long long>(8 + (b - 16) % 8) << (1 + (b - 16) / 8);
+    }
+    // Latency (ns, the low edge of its bucket) that a fraction q of the timed calls came in under, e.g. 0.99
+    unsigned long long Percentile(double q) const {
+      unsigned long long want = static_cast<unsigned long long>(q * timed), seen = 0;
+      for (unsigned int b = 0; b < MMSTAT_BUCKETS; b++) {
+        seen += hist[b];
+        if (seen > want) return BucketLow(b);
+      }
+      return 0;
+    }
+    unsigned long long calls;
+    unsigned long long misses;
+    unsigned long long bytes;
+    unsigned long long timed;
+    unsigned long long hist[MMSTAT_BUCKETS];
+  };
+}
+#endif // MMExt2_Types_H
@@ -33,6 +33,8 @@
 #include <string>
 #include ".\MMExt2\__MMExt2_Internal.hpp"
 #define _myOhv oapiGetFocusInterface()->GetHandle()
+// A NULL ohv below means the focus vessel. Forward clbkFocusChanged to FocusChanged (and call it once from
+// clbkSimulationStart with the focus at the start) and that is one load; otherwise it is asked of Orbiter on each call.
 
 using namespace std;
 namespace MMExt2
@@ -41,31 +43,89 @@ namespace MMExt2
   class Advanced {
   public:
     Advanced(const string &mod) : m_i(mod) {};
-    template<typename T> bool Get(const string& mod, const string& var, T* val, const OBJHANDLE& ohv = _myOhv) const  { return m_i._Get(mod, var, val, ohv); }
-    bool Delete(const string& var, const OBJHANDLE& ohv = _myOhv) const                                               { return m_i._Del(var, ohv); }
-    bool Put(const string& var, const char* val,   const OBJHANDLE& ohv = _myOhv) const                               { return m_i._Put(var, string(val), ohv); }
-    bool Put(const string& var, const string& val, const OBJHANDLE& ohv = _myOhv) const                               { return m_i._Put(var, val, ohv); }
-    template<typename T> bool Put(const string& var, const T& val, const OBJHANDLE& ohv = _myOhv) const               { return m_i._Put(var, val, ohv); }
+    template<typename T> bool Get(const string& mod, const string& var, T* val, const OBJHANDLE& ohv = NULL) const    { return m_i._Get(mod, var, val, ohv); }
+    bool Delete(const string& var, const OBJHANDLE& ohv = NULL) const                                                 { return m_i._Del(var, ohv); }
+    bool Put(const string& var, const char* val,   const OBJHANDLE& ohv = NULL) const                                 { return m_i._Put(var, val, ohv); }
+    bool Put(const string& var, const string& val, const OBJHANDLE& ohv = NULL) const                                 { return m_i._Put(var, val, ohv); }
+    template<typename T> bool Put(const string& var, const T& val, const OBJHANDLE& ohv = NULL) const                 { return m_i._Put(var, val, ohv); }
 
-    template<typename T> bool PutMMStruct(const string& var, const T& val, const OBJHANDLE& ohv = _myOhv) const;
+    bool Resolve(const string& mod, const string& var, MMKey* key, const OBJHANDLE& ohv = NULL) const             { return m_i._Resolve(mod, var, key, ohv); }
+    bool Resolve(const string& var, MMKey* key, const OBJHANDLE& ohv = NULL) const                                { return m_i._Resolve(var, key, ohv); }
+    template<typename T> bool Get(const MMKey& key, T* val) const                                                     { return m_i._Get(key, val); }
+    // A string can also be read into an MMStrView: one call, and no copy or allocation (see __MMExt2_Types.hpp for how
+    // long the view is good for). This works for both the Get and GetIfChanged forms.
+    bool Put(const MMKey& key, const char* val) const                                                                 { return m_i._Put(key, val); }
+    template<typename T> bool Put(const MMKey& key, const T& val) const                                               { return m_i._Put(key, val); }
+
+    // GetIfChanged only takes a key: Resolve it once and keep it. By name, each call would pay a lookup (and a miss a
+    // second DLL call), which costs more than the copy it saves.
+    template<typename T> bool GetIfChanged(const MMKey& key, T* val, unsigned int* gen) const                        { return m_i._GetIfChanged(key, val, gen); }
+
+    bool GetMany(MMBatchItem* items, const size_t& n) const                                                           { return m_i._GetBatch(items, n); }
+    bool PutMany(MMBatchItem* items, const size_t& n) const                                                           { return m_i._PutBatch(items, n); }
+
+    template<typename T> bool PutMMStruct(const string& var, const T& val, const OBJHANDLE& ohv = NULL) const;
     template<typename T> bool GetMMStruct(const string& mod, const string& var, T* val, const unsigned int& ver,
-                                          const unsigned int& siz, const OBJHANDLE& ohv = _myOhv) const;
+                                          const unsigned int& siz, const OBJHANDLE& ohv = NULL) const;
 
     //Remove support for old EnjoLib::ModuleMessagingExtBase. Please use MMStruct from now on. 
-    //template<typename T> bool PutMMBase(  const string var, const T val, const OBJHANDLE ohv = _myOhv) const;
+    //template<typename T> bool PutMMBase(  const string var, const T val, const OBJHANDLE ohv = NULL) const;
     //template<typename T> bool GetMMBase(  const string mod, const string var, T* val, const unsigned int ver,
-    //                                      const unsigned int siz, const OBJHANDLE ohv = _myOhv) const;
+    //                                      const unsigned int siz, const OBJHANDLE ohv = NULL) const;
 
     bool GetLog(char *rFunc, string *rCli, string *rMod, string *rVar, string *rVes,
                 bool *rSucc, int *ix, const bool& skipSelf = true)                                                 { return m_i._GetLog(rFunc, rCli, rMod, rVar, rVes, rSucc, ix, skipSelf); }
     bool RstLog()                                                                                                  { return m_i._RstLog(); }
+    bool SetLogMode(const MMLogMode& mode, const unsigned int& sample = 100)                                       { return m_i._SetLogMode(mode, sample); }
     bool GetVersion(string* ver) const                                                                             { return m_i._GetVer(ver); }
     bool Find(char *rTyp, string* rMod, string* rVar, OBJHANDLE* rOhv, int *ix, 
               const string& mod, const string& var, const OBJHANDLE& ohv = NULL, const bool& skipSelf = true)      { return m_i._Find(rTyp, rMod, rVar, rOhv, ix, mod, var, ohv, skipSelf); }
+    bool Find(char *rTyp, string* rMod, string* rVar, OBJHANDLE* rOhv, MMCursor *cur,
+              const string& mod, const string& var, const OBJHANDLE& ohv = NULL, const bool& skipSelf = true)      { return m_i._Find(rTyp, rMod, rVar, rOhv, cur, mod, var, ohv, skipSelf); }
+    const MMFindList& FindAll(const string& mod, const string& var, const OBJHANDLE& ohv = NULL,
+                              const bool& skipSelf = true)                                                         { m_i._FindAll(&m_found, mod, var, ohv, skipSelf); return m_found; }
+    bool Subscribe(unsigned int* id, const string& mod, const string& var, const OBJHANDLE& ohv, MMNotifyFunc fn, void* ctx = NULL,
+                   const MMNotifyMode& mode = MMNOTIFY_FRAME, const bool& skipSelf = true)                         { return m_i._Subscribe(id, mod, var, ohv, fn, ctx, mode, skipSelf); }
+    bool Unsubscribe(const unsigned int& id)                                                                       { return m_i._Unsubscribe(id); }
+    bool Dispatch()                                                                                                { return m_i._Dispatch(); }
+    // For a module with an oapi::Module instance: call VesselEvents() once, and VesselDeleted(hVessel) from its
+    // clbkDeleteVessel. The core then purges dead vessels' keys as they go, rather than checking handles on every call.
+    bool VesselEvents(const bool& on = true)                                                                       { return m_i._VesselEvents(on); }
+    bool VesselDeleted(const OBJHANDLE& ohv)                                                                       { return m_i._VesselDeleted(ohv); }
     void UpdMod(const string& mod)                                                                                 { return m_i._UpdMod(mod); }
     int  ObjType(const OBJHANDLE& val) const                                                                       { return m_i._ObjType(val); }
+    bool ObjCacheStats(unsigned long long* hits, unsigned long long* misses) const                                 { return m_i._ObjCacheStats(hits, misses); }
+    void FocusChanged(const OBJHANDLE& ohv)                                                                        { m_i._FocusChanged(ohv); }  // from clbkFocusChanged, see above
+    bool MemStats(size_t* reserved, size_t* used) const                                                            { return m_i._MemStats(reserved, used); }
+    // Drops every key and value in the core, and the memory behind them. For the end of a simulation session, once all
+    // clients are done with it (e.g. from clbkSimulationEnd). Keys resolved before it fail from then on: resolve again.
+    bool ResetSession()                                                                                            { return m_i._ResetSession(); }
+    // Saves every client's values to a file, and loads them back, e.g. next to a scenario from clbkSaveState and
+    // clbkLoadStateEx. Vessels (and object values) are saved by name. MMStruct and MMBase values are not saved.
+    bool Snapshot(const string& path) const                                                                        { return m_i._Snapshot(path); }
+    bool Restore(const string& path) const                                                                         { return m_i._Restore(path); }
+    // Records all Put and Delete traffic on the bus (every client's, not just yours) to a file until RecordStop, for
+    // timing investigations and regression runs. Cheap enough to leave on. Replay plays a recording back, in order.
+    bool RecordStart(const string& path)                                                                           { return m_i._RecordStart(path); }
+    bool RecordStop()                                                                                              { return m_i._RecordStop(); }
+    bool Replay(const string& path)                                                                                { return m_i._Replay(path); }
+    // The n keys getting the most Get and Put calls per sim second, across all clients, since the last ResetSession.
+    // For finding keys polled far more often than they change. Set HotKeyDump = <file> in MMExt2.cfg to have the top
+    // keys appended to that file at each ResetSession, i.e. at each sim end.
+    const MMHotList& HotKeys(const size_t& n = 10)                                                                 { m_i._HotKeys(&m_hot, n); return m_hot; }
+    // Writes a timeline of every client's Put, Get, Delete, Find and GetLog calls to a Chrome trace JSON file (open it
+    // in chrome://tracing or Perfetto), each tagged with client, module, variable and frame number. Timestamps are the
+    // host's steady clock, so the trace lines up with your own module's traces on the same clock.
+    bool TraceStart(const string& path)                                                                            { return m_i._TraceStart(path); }
+    bool TraceStop()                                                                                               { return m_i._TraceStop(); }
+    // Call counts, misses, bytes and a latency histogram for one client and operation (see MMStats). Either by client
+    // name, or walking every client: start *ix at 0, and call until it returns false.
+    bool GetStats(const string& cli, const MMStatOp& op, MMStats* stats) const                                     { return m_i._GetStats(cli, op, stats); }
+    bool GetStats(unsigned int* ix, string* cli, const MMStatOp& op, MMStats* stats) const                         { return m_i._GetStats(ix, cli, op, stats); }
   private:
     Internal m_i;
+    MMFindList m_found;
+    MMHotList m_hot;
   };
   
   // Inline implementation allows this to be included in multiple compilation units 
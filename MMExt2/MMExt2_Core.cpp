@@ -26,9 +26,17 @@
 
 #include "MMExt2_Core.hpp"
 #include <algorithm>
-#include <sstream>
+#include <cstring>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
+#ifdef _MSC_VER
 #pragma warning( default : 4571 ) // Enables exception on try/catch with no SEH enabled - i.e. C++ Code Generation, Enable C++ Exceptions, Yes with SEH exceptions (/EHa).
+#endif
 
 using namespace MMExt2;
 using namespace std;
@@ -36,24 +44,136 @@ using namespace std;
 #define MMEXT2_VERSION_NUMBER "v2.1"
 #define TOKEN_VALUE 186
 
+#define BLOCK_SHIFT 8
+#define BLOCK_SIZE (1 << BLOCK_SHIFT)
+#define MAX_BLOCKS 65536
+#define INDEX_BITS 24       // low bits of a key handle: entry index + 1. The rest hold the session.
+#define INDEX_MASK ((1u << INDEX_BITS) - 1)
+#define ARENA_CHUNK 65536
+#define STR_MIN 16
+#define STR_MAX (STR_MIN << (STR_CLASSES - 1))
+#define SHARD_BITS 4
+#define SHARD_COUNT (1 << SHARD_BITS)
+#define MIN_SLOTS 64
+#define TYPE_MEMO 256
+#define LOG_CAPACITY 16384
+#define LOG_SAMPLE 100
+#define QUERY_CAPACITY 4096 // distinct names of logged misses and wildcard queries
+#define STAT_SAMPLE 8       // one call in this many, per thread, is timed for the latency histograms
+#define HOT_SLOTS 64        // keys tracked by the hot key profiler
+#define HOT_DUMP 20         // keys written out by HotKeyDump
+#ifdef _WIN32
+#define CONFIG_FILE ".\\Modules\\MMExt2.cfg"
+#else
+#define CONFIG_FILE "./Modules/MMExt2.cfg"
+#endif
+#define SNAP_MAGIC "MMX2SNAP"
+#define SNAP_VERSION 1
+#define REC_MAGIC "MMX2STRM"
+#define REC_VERSION 1
+#define REC_HEAD 25          // bytes of record header: sequence, sim time, key handle, type, value length
+#define REC_BLOCK 65536      // raw bytes per compressed block
+#define REC_FLUSH 262144     // a thread buffer this full wakes the writer early
+#define REC_PERIOD 100       // ms between writer passes
+#define TRACE_RING 65536     // events per thread ring, a power of two
+#define TRACE_PERIOD 50      // ms between tracer writer passes
+
+// The recorder's and tracer's statics are defined ahead of gCore, so they outlive its destructor, which stops a
+// recording or trace still running at unload
+thread_local MMExt2_Core::RecBuf MMExt2_Core::m_recLocal;
+atomic<bool> MMExt2_Core::m_recOn(false);
+atomic<unsigned int> MMExt2_Core::m_recEpoch(0);
+atomic<unsigned long long> MMExt2_Core::m_recSeq(0);
+mutex MMExt2_Core::m_recLock;
+vector<MMExt2_Core::RecBuf*> MMExt2_Core::m_recBufs;
+vector<char> MMExt2_Core::m_recLeft;
+condition_variable MMExt2_Core::m_recWake;
+bool MMExt2_Core::m_recStop = false;
+thread MMExt2_Core::m_recThread;
+mutex MMExt2_Core::m_recCtl;
+mutex MMExt2_Core::m_recWrite;
+FILE* MMExt2_Core::m_recFile = NULL;
+vector<char> MMExt2_Core::m_recBlock;
+thread_local MMExt2_Core::TraceBuf MMExt2_Core::m_trcLocal;
+atomic<bool> MMExt2_Core::m_trcOn(false);
+atomic<unsigned long long> MMExt2_Core::m_trcDropped(0);
+mutex MMExt2_Core::m_trcLock;
+vector<MMExt2_Core::TraceBuf*> MMExt2_Core::m_trcBufs;
+unsigned int MMExt2_Core::m_trcTids = 0;
+condition_variable MMExt2_Core::m_trcWake;
+bool MMExt2_Core::m_trcStop = false;
+thread MMExt2_Core::m_trcThread;
+mutex MMExt2_Core::m_trcCtl;
+FILE* MMExt2_Core::m_trcFile = NULL;
+bool MMExt2_Core::m_trcFirst = true;
+mutex MMExt2_Core::m_trcFrameLock;
+double MMExt2_Core::m_trcFrameAt = 0.0;
+unsigned int MMExt2_Core::m_trcFrame = 0;
+string MMExt2_Core::m_hotDump;        // ahead of gCore too, as its constructor reads the config
+thread_local MMExt2_Core::HotTable MMExt2_Core::m_hotLocal;
+mutex MMExt2_Core::m_hotLock;
+vector<MMExt2_Core::HotTable*> MMExt2_Core::m_hotTables;
+unordered_map<unsigned int, MMExt2_Core::HotSlot> MMExt2_Core::m_hotLeft;
+double MMExt2_Core::m_hotLeftFrom = -1.0;
+
 MMExt2_Core gCore;
-map<string, bool> MMExt2_Core::m_bools;
-map<string, int> MMExt2_Core::m_ints;
-map<string, double> MMExt2_Core::m_doubles;
-map<string, VECTOR3> MMExt2_Core::m_VECTOR3s;
-map<string, MATRIX3> MMExt2_Core::m_MATRIX3s;
-map<string, MATRIX4> MMExt2_Core::m_MATRIX4s;
-map<string, string> MMExt2_Core::m_strings;
-map<string, const MMStruct*> MMExt2_Core::m_MMStructs;
-map<string, const EnjoLib::ModuleMessagingExtBase*> MMExt2_Core::m_MMBases;
-map<string, OBJHANDLE> MMExt2_Core::m_OBJHANDLEs;
-map<string, char> MMExt2_Core::m_types;
-vector<string>  MMExt2_Core::m_activitylog;
+unique_ptr<MMExt2_Core::Entry[]> MMExt2_Core::m_blocks[MAX_BLOCKS];
+atomic<unsigned int> MMExt2_Core::m_count(0);
+atomic<unsigned int> MMExt2_Core::m_session(0);
+mutex MMExt2_Core::m_grow;
+MMExt2_Core::Arena MMExt2_Core::m_names;
+MMExt2_Core::Shard MMExt2_Core::m_shards[SHARD_COUNT];
+unordered_map<string, MMExt2_Core::HandleList> MMExt2_Core::m_byMod;
+unordered_map<string, MMExt2_Core::HandleList> MMExt2_Core::m_byVar;
+unordered_map<OBJHANDLE, MMExt2_Core::HandleList> MMExt2_Core::m_byVes;
+shared_timed_mutex MMExt2_Core::m_index;
+atomic<bool> MMExt2_Core::m_seqRead(true);
+mutex MMExt2_Core::m_vesLock;
+set<string> MMExt2_Core::m_vesClis;
+atomic<bool> MMExt2_Core::m_vesEvents(false);
+thread_local MMExt2_Core::TypeMemo MMExt2_Core::m_typeMemo[TYPE_MEMO];
+atomic<unsigned int> MMExt2_Core::m_typeGen(1);
+atomic<unsigned int> MMExt2_Core::m_frame(0);
+atomic<unsigned long long> MMExt2_Core::m_typeHits(0);
+atomic<unsigned long long> MMExt2_Core::m_typeMisses(0);
+map<unsigned int, shared_ptr<MMExt2_Core::Sub>> MMExt2_Core::m_subs;
+unordered_map<unsigned int, MMExt2_Core::SubList> MMExt2_Core::m_subByKey;
+unordered_map<string, MMExt2_Core::SubList> MMExt2_Core::m_subByMod;
+unordered_map<string, MMExt2_Core::SubList> MMExt2_Core::m_subByVar;
+unordered_map<OBJHANDLE, MMExt2_Core::SubList> MMExt2_Core::m_subByVes;
+MMExt2_Core::SubList MMExt2_Core::m_subAll;
+shared_timed_mutex MMExt2_Core::m_subLock;
+atomic<unsigned int> MMExt2_Core::m_subCount(0);
+unsigned int MMExt2_Core::m_subNext = 0;
+thread_local vector<const MMExt2_Core::Sub*> MMExt2_Core::m_subHeld;
+thread_local MMExt2_Core::FindMemo MMExt2_Core::m_findMemo;
+thread_local MMExt2_Core::LogSeen MMExt2_Core::m_logLocal;
+mutex MMExt2_Core::m_logLock;
+atomic<unsigned int> MMExt2_Core::m_logEpoch(0);
+atomic<int> MMExt2_Core::m_logMode(MMLOG_FIRST);
+atomic<unsigned int> MMExt2_Core::m_logSample(LOG_SAMPLE);
+atomic<unsigned int> MMExt2_Core::m_logTick(0);
+vector<MMExt2_Core::LogRec> MMExt2_Core::m_log;
+size_t MMExt2_Core::m_logHead = 0;
+size_t MMExt2_Core::m_logCount = 0;
+unordered_set<unsigned long long> MMExt2_Core::m_logSeen;
+shared_timed_mutex MMExt2_Core::m_qryLock;
+deque<MMExt2_Core::Query> MMExt2_Core::m_qrys;
+unordered_multimap<unsigned int, unsigned int> MMExt2_Core::m_qryIxs;
+shared_timed_mutex MMExt2_Core::m_cliLock;
+deque<string> MMExt2_Core::m_clis;
+deque<MMExt2_Core::CliStats> MMExt2_Core::m_cliStats;
+unordered_map<string, unsigned int> MMExt2_Core::m_cliIxs;
 const char MMExt2_Core::m_token = char(TOKEN_VALUE);
 
-MMExt2_Core::MMExt2_Core() {}
+MMExt2_Core::MMExt2_Core() {
+  LoadConfig();
+}
 
-MMExt2_Core::~MMExt2_Core() {}
+MMExt2_Core::~MMExt2_Core() {
+  RecordStop();
+  TraceStop();
+}
 
 inline int _ObjType(const OBJHANDLE& val) {
   int obj_type = OBJTP_INVALID;
@@ -70,315 +190,2274 @@ inline bool _IsVessel(OBJHANDLE ohv) {
   return (_ObjType(ohv) == OBJTP_VESSEL); // Looking for 10. If 0, then objtype is INVALID. Check if they are sending an OBJHANDLE or a VESSEL* ... we want an OBJHANDLE. 
 }
 
-inline std::string _Id(const char* mod, const char* var, const OBJHANDLE ohv, const bool allowNullOhv = false) {
-  const char token = char(TOKEN_VALUE);
-  string id = "", s_ohv = "", s_mod = mod, s_var = var;
-  if (!allowNullOhv) {
-    if (!_IsVessel(ohv)) return id;
+inline bool _ValidName(const char* s) {
+  return (s[0] != '\0' && strchr(s, TOKEN_VALUE) == NULL);
+}
+
+// FNV-1a over the handle bytes and both names, so the key is hashed straight from the caller's strings
+inline unsigned int _Hash(const OBJHANDLE ohv, const char* mod, const char* var) {
+  unsigned int h = 2166136261u;
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(&ohv);
+  for (size_t i = 0; i < sizeof(ohv); i++) h = (h ^ p[i]) * 16777619u;
+  for (p = reinterpret_cast<const unsigned char*>(mod); *p; p++) h = (h ^ *p) * 16777619u;
+  h = (h ^ TOKEN_VALUE) * 16777619u;
+  for (p = reinterpret_cast<const unsigned char*>(var); *p; p++) h = (h ^ *p) * 16777619u;
+  return h;
+}
+
+// Whether a Put actually changes the stored value
+template<class T> inline bool _Same(const T& a, const T& b) { return memcmp(&a, &b, sizeof(T)) == 0; }
+
+// Dedup signature of a log record: everything except the sim time
+inline unsigned long long _LogSig(const unsigned int cli, const unsigned int h, const char act, const bool res, const bool query) {
+  return (static_cast<unsigned long long>(h) << 32) | (query ? 0x80000000ull : 0) | (static_cast<unsigned long long>(cli & 0x7FFFFF) << 8) |
+         ((act & 0x7F) << 1) | (res ? 1 : 0);
+}
+
+// A handle from before the last ResetSession carries the wrong session, so it is refused rather than landing on
+// whichever key has since taken its index
+MMExt2_Core::Entry* MMExt2_Core::_Entry(const MMKey& key) {
+  unsigned int ix = key.h & INDEX_MASK;
+  if (ix == 0 || (key.h >> INDEX_BITS) != m_session.load(memory_order_relaxed) || ix > m_count.load(memory_order_acquire)) return NULL;
+  ix--;
+  return &m_blocks[ix >> BLOCK_SHIFT][ix & (BLOCK_SIZE - 1)];
+}
+
+unsigned int MMExt2_Core::_Handle(const unsigned int ix) {
+  return (m_session.load(memory_order_relaxed) << INDEX_BITS) | (ix + 1);
+}
+
+void* MMExt2_Core::Arena::Alloc(size_t n) {
+  n = (n + 7) & ~static_cast<size_t>(7);
+  if (n > left) {
+    size_t sz = max(n, static_cast<size_t>(ARENA_CHUNK));
+    chunks.push_back(unique_ptr<char[]>(new char[sz]));
+    next = chunks.back().get();
+    left = sz;
+    reserved += sz;
   }
-  char c_ohv[32];
-  sprintf_s(c_ohv, 32, "%p", ohv);
-  s_ohv = c_ohv;
-  if (s_mod.length() == 0 || s_var.length() == 0) return id;
-  if (s_mod.find(token) != -1 || s_var.find(token) != -1) return id;
-  id = s_ohv + token + s_mod + token + s_var;
-  return id;
+  void* p = next;
+  next += n;
+  left -= n;
+  used += n;
+  return p;
 }
 
-inline void _RemoteCopy(char* rS, size_t *rLenS, const string &lS) {
-  if (lS.length() < *rLenS) strcpy_s(rS, *rLenS, lS.c_str());
-  *rLenS = lS.length() + 1;
+void MMExt2_Core::Arena::Release() {
+  chunks.clear();
+  next = NULL;
+  left = reserved = used = 0;
 }
 
-template<class T>
-static bool MMExt2_Core::SearchMap(const string& get, const string& id, const map<string, T>& mapToSearch, T* returnValue) {
-  if (id.length() == 0) return false;
-  map<string, T>::const_iterator it = mapToSearch.find(id);
-  if (it != mapToSearch.end()) {
-    *returnValue = it->second;
-    return Log(get, "G", true, id);
+MMExt2_Core::StrPool::StrPool() : bigBytes(0), used(0) {
+  for (int c = 0; c < STR_CLASSES; c++) free[c] = NULL;
+}
+
+inline int _StrClass(size_t n) {
+  int c = 0;
+  for (size_t sz = STR_MIN; sz < n; sz <<= 1) c++;
+  return c;
+}
+
+char* MMExt2_Core::StrPool::Alloc(size_t n, unsigned int* cap) {
+  char* p;
+  if (n > STR_MAX) {
+    p = new char[n];
+    big.insert(p);
+    bigBytes += n;
+    *cap = static_cast<unsigned int>(n);
+  } else {
+    int c = _StrClass(n);
+    *cap = STR_MIN << c;
+    p = free[c];
+    if (p) {
+      free[c] = *reinterpret_cast<char**>(p);
+    } else {
+      p = static_cast<char*>(arena.Alloc(*cap));
+    }
+  }
+  used += *cap;
+  return p;
+}
+
+void MMExt2_Core::StrPool::Free(char* p, unsigned int cap) {
+  used -= cap;
+  if (cap > STR_MAX) {
+    big.erase(p);
+    bigBytes -= cap;
+    delete[] p;
+    return;
+  }
+  int c = _StrClass(cap);
+  *reinterpret_cast<char**>(p) = free[c];
+  free[c] = p;
+}
+
+void MMExt2_Core::StrPool::Release() {
+  for (char* p : big) delete[] p;
+  big.clear();
+  bigBytes = used = 0;
+  for (int c = 0; c < STR_CLASSES; c++) free[c] = NULL;
+  arena.Release();
+}
+
+MMExt2_Core::Shard& MMExt2_Core::_Shard(const unsigned int hash) {
+  return m_shards[hash >> (32 - SHARD_BITS)]; // top bits pick the shard, low bits the slot within it
+}
+
+void MMExt2_Core::Rehash(Shard& sh, const size_t slots) {
+  vector<Slot> old;
+  old.swap(sh.slots);
+  Slot empty = { 0, 0 };
+  sh.slots.assign(slots, empty);
+  size_t mask = slots - 1;
+  for (const auto& s : old) {
+    if (s.h == 0) continue;
+    size_t i = s.hash & mask;
+    while (sh.slots[i].h != 0) i = (i + 1) & mask;
+    sh.slots[i] = s;
+  }
+}
+
+// Looks the key up in its shard (caller holds the shard lock). Returns the handle, or 0 with pos at the free slot.
+unsigned int MMExt2_Core::Probe(const Shard& sh, const unsigned int hash, const OBJHANDLE ohv, const char* mod, const char* var, size_t* pos) {
+  if (sh.slots.empty()) return 0;
+  size_t mask = sh.slots.size() - 1;
+  size_t i = hash & mask;
+  for (; sh.slots[i].h != 0; i = (i + 1) & mask) {
+    if (sh.slots[i].hash != hash) continue;
+    MMKey key;
+    key.h = sh.slots[i].h;
+    const Entry* e = _Entry(key);
+    if (e->ohv == ohv && *e->mod == mod && !strcmp(e->var, var)) return key.h;
+  }
+  *pos = i;
+  return 0;
+}
+
+unsigned int MMExt2_Core::NewEntry(const unsigned int hash, const OBJHANDLE ohv, const char* mod, const char* var) {
+  lock_guard<mutex> lk(m_grow);
+  unsigned int ix = m_count.load(memory_order_relaxed);
+  if ((ix >> BLOCK_SHIFT) >= MAX_BLOCKS || ix + 1 > INDEX_MASK) return 0;
+  if ((ix & (BLOCK_SIZE - 1)) == 0) m_blocks[ix >> BLOCK_SHIFT].reset(new Entry[BLOCK_SIZE]);
+  Entry& e = m_blocks[ix >> BLOCK_SHIFT][ix & (BLOCK_SIZE - 1)];
+  unsigned int c = Client(mod);
+  {
+    shared_lock<shared_timed_mutex> rd(m_cliLock);
+    e.mod = &m_clis[c];
+  }
+  size_t lVar = strlen(var) + 1;
+  char* v = static_cast<char*>(m_names.Alloc(lVar));
+  memcpy(v, var, lVar);
+  e.var = v;
+  e.ohv = ohv;
+  e.hash = hash;
+  e.typ = '\0';
+  m_count.store(ix + 1, memory_order_release);
+  return _Handle(ix);
+}
+
+unsigned int MMExt2_Core::Intern(const OBJHANDLE ohv, const char* mod, const char* var) {
+  unsigned int hash = _Hash(ohv, mod, var);
+  Shard& sh = _Shard(hash);
+  size_t i = 0;
+  unsigned int h;
+  {
+    shared_lock<shared_timed_mutex> rd(sh.lock);
+    h = Probe(sh, hash, ohv, mod, var, &i);
+  }
+  if (!h) {
+    unique_lock<shared_timed_mutex> wr(sh.lock);
+    h = Probe(sh, hash, ohv, mod, var, &i);  // someone else may have added it since the read lock was dropped
+    if (!h) {
+      if ((sh.count + 1) * 2 > sh.slots.size()) {
+        Rehash(sh, sh.slots.empty() ? MIN_SLOTS : sh.slots.size() * 2);
+        Probe(sh, hash, ohv, mod, var, &i);
+      }
+      h = NewEntry(hash, ohv, mod, var);
+      if (!h) return 0;
+      sh.slots[i].hash = hash;
+      sh.slots[i].h = h;
+      sh.count++;
+    }
+  }
+  Index(h);
+  return h;
+}
+
+// Index lists are kept in handle order. A new key goes on the end; only a key indexed again (see VesselDeleted) or one
+// that lost a race to the index lock lands further in.
+inline void _Insert(vector<unsigned int>& list, const unsigned int h) {
+  if (list.empty() || list.back() < h) {
+    list.push_back(h);
+  } else {
+    list.insert(upper_bound(list.begin(), list.end(), h), h);
+  }
+}
+
+// Adds a key to the Find indexes, once. Until then, a key a Put is still interning is not found.
+void MMExt2_Core::Index(const unsigned int h) {
+  MMKey key;
+  key.h = h;
+  Entry* e = _Entry(key);
+  if (e->indexed.load(memory_order_acquire)) return;
+  unique_lock<shared_timed_mutex> wr(m_index);
+  if (e->indexed.load(memory_order_relaxed)) return;
+  _Insert(m_byMod[*e->mod], h);
+  _Insert(m_byVar[e->var], h);
+  _Insert(m_byVes[e->ohv], h);
+  e->indexed.store(true, memory_order_release);
+}
+
+unsigned int MMExt2_Core::Lookup(const OBJHANDLE ohv, const char* mod, const char* var) {
+  unsigned int hash = _Hash(ohv, mod, var);
+  Shard& sh = _Shard(hash);
+  size_t i;
+  shared_lock<shared_timed_mutex> rd(sh.lock);
+  return Probe(sh, hash, ohv, mod, var, &i);
+}
+
+// With vessel events on, a live key resolves from the index alone. Otherwise (or for a new or dead key) the handle is
+// checked to be a live vessel first.
+bool MMExt2_Core::Resolve(const char* mod, const char* var, const OBJHANDLE ohv, MMKey* key) {
+  key->h = 0;
+  if (!_ValidName(mod) || !_ValidName(var)) return false;
+  if (m_vesEvents.load(memory_order_relaxed)) {
+    key->h = Lookup(ohv, mod, var);
+    Entry* e = _Entry(*key);
+    if (e && e->indexed.load(memory_order_acquire) && !e->dead.load(memory_order_acquire)) return true;
+    key->h = 0;
+  }
+  if (HandleType(ohv) != OBJTP_VESSEL) return false;
+  key->h = Intern(ohv, mod, var);
+  if (!key->IsValid()) return false;
+  Entry* e = _Entry(*key);
+  if (e->dead.load(memory_order_acquire)) e->dead.store(false, memory_order_release);  // a new vessel on a deleted one's handle
+  return true;
+}
+
+// A key is only found once it is indexed, i.e. once a Put or Resolve has made it
+bool MMExt2_Core::LookupKey(const char* cli, const char act, const char* mod, const char* var, const OBJHANDLE ohv, MMKey* key) {
+  key->h = 0;
+  if (!_ValidName(mod) || !_ValidName(var)) return false;
+  key->h = Lookup(ohv, mod, var);
+  Entry* e = _Entry(*key);
+  bool live = (m_vesEvents.load(memory_order_relaxed) || HandleType(ohv) == OBJTP_VESSEL);
+  if (e && live && e->indexed.load(memory_order_acquire) && !e->dead.load(memory_order_acquire)) return true;
+  key->h = 0;
+  if (live) Log(cli, act, false, ohv, mod, var);
+  return false;
+}
+
+// Logging is checked here first so that the Put/Get hot path pays a single compare when the log is off
+inline bool MMExt2_Core::Log(const char* cli, const char act, const bool& res, const MMKey& key) {
+  if (m_logMode.load(memory_order_relaxed) == MMLOG_OFF) return res;
+  return Record(cli, act, res, key.h);
+}
+
+inline bool MMExt2_Core::Log(const char* cli, const char act, const bool& res, const OBJHANDLE ohv, const char* mod, const char* var) {
+  if (m_logMode.load(memory_order_relaxed) == MMLOG_OFF) return res;
+  unsigned int q = LogQuery(ohv, mod, var);
+  if (!q) return res;
+  return Record(cli, act, res, q, true);
+}
+
+// Index + 1 of the names in m_qrys, added if new. 0 once the table is full.
+unsigned int MMExt2_Core::LogQuery(const OBJHANDLE ohv, const char* mod, const char* var) {
+  unsigned int hash = _Hash(ohv, mod, var);
+  {
+    shared_lock<shared_timed_mutex> rd(m_qryLock);
+    auto r = m_qryIxs.equal_range(hash);
+    for (auto it = r.first; it != r.second; ++it) {
+      const Query& q = m_qrys[it->second - 1];
+      if (q.ohv == ohv && q.mod == mod && q.var == var) return it->second;
+    }
+  }
+  unique_lock<shared_timed_mutex> wr(m_qryLock);
+  auto r = m_qryIxs.equal_range(hash);
+  for (auto it = r.first; it != r.second; ++it) {
+    const Query& q = m_qrys[it->second - 1];
+    if (q.ohv == ohv && q.mod == mod && q.var == var) return it->second;
+  }
+  if (m_qrys.size() >= QUERY_CAPACITY) return 0;
+  Query q = { ohv, mod, var, hash };
+  m_qrys.push_back(q);
+  m_qryIxs.emplace(hash, static_cast<unsigned int>(m_qrys.size()));
+  return static_cast<unsigned int>(m_qrys.size());
+}
+
+template<> bool& MMExt2_Core::_Val<bool>(Entry& e)                                                  { return e.val.b;  }
+template<> int& MMExt2_Core::_Val<int>(Entry& e)                                                    { return e.val.i;  }
+template<> double& MMExt2_Core::_Val<double>(Entry& e)                                              { return e.val.d;  }
+template<> VECTOR3& MMExt2_Core::_Val<VECTOR3>(Entry& e)                                            { return e.val.v;  }
+template<> MATRIX3& MMExt2_Core::_Val<MATRIX3>(Entry& e)                                            { return e.val.m3; }
+template<> MATRIX4& MMExt2_Core::_Val<MATRIX4>(Entry& e)                                            { return e.val.m4; }
+template<> OBJHANDLE& MMExt2_Core::_Val<OBJHANDLE>(Entry& e)                                        { return e.val.o;  }
+template<> const MMStruct*& MMExt2_Core::_Val<const MMStruct*>(Entry& e)                            { return e.val.x;  }
+template<> const EnjoLib::ModuleMessagingExtBase*& MMExt2_Core::_Val<const EnjoLib::ModuleMessagingExtBase*>(Entry& e)
+                                                                                                    { return e.val.y;  }
+
+// Value compare and store for PutSlot. Strings have their own overloads, as they are held inline or in the shard's pool.
+template<class T> bool MMExt2_Core::Holds(Entry& e, const T& val)            { return _Same<T>(_Val<T>(e), val); }
+template<class T> void MMExt2_Core::Store(Shard&, Entry& e, const T& val)    { _Val<T>(e) = val; }
+
+const char* MMExt2_Core::_Str(const Entry& e) {
+  return (e.str.p ? e.str.p : e.val.s);
+}
+
+bool MMExt2_Core::Holds(Entry& e, const char* val) {
+  size_t n = strlen(val);
+  return e.str.n == n && !memcmp(_Str(e), val, n);
+}
+
+// A short string is copied straight into the value slot. A long one reuses its pool block while the new string fits,
+// much as std::string keeps its capacity, so a status string rewritten at the same length is only ever a memcpy.
+void MMExt2_Core::Store(Shard& sh, Entry& e, const char* val) {
+  size_t n = strlen(val) + 1;
+  if (n <= sizeof(e.val.s)) {
+    if (e.str.p) Clear(sh, e);
+    memcpy(e.val.s, val, n);
   } else {
-    return Log(get, "G", false, id);
+    if (n > e.str.cap) {
+      if (e.str.p) sh.strs.Free(e.str.p, e.str.cap);
+      e.str.p = sh.strs.Alloc(n, &e.str.cap);
+    }
+    memcpy(e.str.p, val, n);
+  }
+  e.str.n = static_cast<unsigned int>(n - 1);
+}
+
+void MMExt2_Core::Clear(Shard& sh, Entry& e) {
+  if (e.str.p) sh.strs.Free(e.str.p, e.str.cap);
+  e.str.p = NULL;
+  e.str.n = e.str.cap = 0;
+}
+
+// Reverse index of stored handle values, so VesselDeleted finds the keys pointing at a vessel without a sweep. Kept
+// by whatever changes a key's value to or from an OBJHANDLE, with the key's shard locked exclusively.
+void MMExt2_Core::ObjLink(Shard& sh, const unsigned int h, const OBJHANDLE obj) {
+  sh.objs[obj].push_back(h);
+}
+
+void MMExt2_Core::ObjUnlink(Shard& sh, const unsigned int h, const OBJHANDLE obj) {
+  unordered_map<OBJHANDLE, vector<unsigned int>>::iterator it = sh.objs.find(obj);
+  if (it == sh.objs.end()) return;
+  vector<unsigned int>& keys = it->second;
+  vector<unsigned int>::iterator at = find(keys.begin(), keys.end(), h);
+  if (at != keys.end()) {
+    *at = keys.back();
+    keys.pop_back();
+  }
+  if (keys.empty()) sh.objs.erase(it);
+}
+
+template<> struct MMExt2_Core::SeqType<bool>    { enum { value = 1 }; };
+template<> struct MMExt2_Core::SeqType<int>     { enum { value = 1 }; };
+template<> struct MMExt2_Core::SeqType<double>  { enum { value = 1 }; };
+template<> struct MMExt2_Core::SeqType<VECTOR3> { enum { value = 1 }; };
+template<> struct MMExt2_Core::SeqType<MATRIX3> { enum { value = 1 }; };
+template<> struct MMExt2_Core::SeqType<MATRIX4> { enum { value = 1 }; };
+
+// Writer side of the sequence counter. Writers already hold the shard lock exclusively, so only one is ever in flight.
+void MMExt2_Core::SeqBegin(Entry& e) {
+  e.seq.store(e.seq.load(memory_order_relaxed) + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+void MMExt2_Core::SeqEnd(Entry& e) {
+  e.seq.store(e.seq.load(memory_order_relaxed) + 1, memory_order_release);
+}
+
+// Lock free read of a fixed size value: take a copy between two reads of an even sequence number. A writer never waits
+// for a reader, and a reader only spins while a write to this very key is in flight.
+template<class T>
+bool MMExt2_Core::SeqGet(Entry& e, const char& typ, T* val, unsigned int* rSeq) {
+  for (;;) {
+    unsigned int seq = e.seq.load(memory_order_acquire);
+    if (seq & 1) {
+      this_thread::yield();
+      continue;
+    }
+    char t = e.typ;
+    T v = _Val<T>(e);
+    atomic_thread_fence(memory_order_acquire);
+    if (e.seq.load(memory_order_relaxed) != seq) continue;
+    *rSeq = seq;
+    if (t != typ) return false;
+    *val = v;
+    return true;
   }
 }
 
+// With gen set, this is GetIfChanged: an unchanged generation returns false straight away, with no copy and no log.
 template<class T>
-static bool MMExt2_Core::SearchMapDelete(const string &id, map<string, T>& mapToSearch) {
-  return (mapToSearch.erase(id)>0);
+bool MMExt2_Core::GetSlot(const char* cli, const MMKey& key, const char& typ, T* val, unsigned int* gen) {
+  unsigned long long t0 = StatBegin();
+  Entry* e = _Entry(key);
+  if (!e) return Stat(cli, MMSTAT_GET, t0, false, 0, key.h);
+  if (gen && (e->seq.load(memory_order_acquire) >> 1) == *gen) return Stat(cli, MMSTAT_GET, t0, false, 0, key.h);
+  bool ok;
+  unsigned int seq;
+  if (SeqType<T>::value && m_seqRead.load(memory_order_relaxed)) {
+    ok = SeqGet<T>(*e, typ, val, &seq);
+  } else {
+    shared_lock<shared_timed_mutex> rd(_Shard(e->hash).lock);
+    seq = e->seq.load(memory_order_relaxed);
+    ok = (e->typ == typ);
+    if (ok) *val = _Val<T>(*e);
+  }
+  if (gen) *gen = seq >> 1;
+  return Stat(cli, MMSTAT_GET, t0, Log(cli, 'G', ok, key), ok ? sizeof(T) : 0, key.h);
+}
+
+// Recorded value bytes for each type. An object goes by name, and MMStruct and MMBase pointers are recorded as empty.
+template<class T> void MMExt2_Core::RecPut(const MMKey& key, Entry& e, const char typ, const T& val) {
+  Rec(key, e, typ, &val, sizeof(T));
+}
+
+// Object names are looked up once per recording, and again only once a vessel has gone (which may free its handle)
+template<> void MMExt2_Core::RecPut<OBJHANDLE>(const MMKey& key, Entry& e, const char typ, const OBJHANDLE& val) {
+  RecBuf& b = m_recLocal;
+  unsigned int epoch = m_recEpoch.load(memory_order_relaxed), gen = m_typeGen.load(memory_order_acquire);
+  if (b.objEpoch != epoch || b.objGen != gen) {
+    b.objNames.clear();
+    b.objEpoch = epoch;
+    b.objGen = gen;
+  }
+  unordered_map<OBJHANDLE, string>::iterator it = b.objNames.find(val);
+  if (it == b.objNames.end()) {
+    char name[256];
+    oapiGetObjectName(val, name, sizeof(name));
+    it = b.objNames.insert(make_pair(val, string(name))).first;
+  }
+  Rec(key, e, typ, it->second.c_str(), it->second.length());
+}
+
+template<> void MMExt2_Core::RecPut<const MMStruct*>(const MMKey& key, Entry& e, const char typ, const MMStruct* const&) {
+  Rec(key, e, typ, NULL, 0);
 }
 
+template<> void MMExt2_Core::RecPut<const EnjoLib::ModuleMessagingExtBase*>(const MMKey& key, Entry& e, const char typ,
+                                                                             const EnjoLib::ModuleMessagingExtBase* const&) {
+  Rec(key, e, typ, NULL, 0);
+}
+
+void MMExt2_Core::RecPut(const MMKey& key, Entry& e, const char typ, const char* val) {
+  Rec(key, e, typ, val, strlen(val));
+}
+
+// Value bytes a Put copies in, for the stats
+template<class T> inline size_t _Bytes(const T&) { return sizeof(T); }
+inline size_t _Bytes(const char* val) { return strlen(val); }
+
 template<class T>
-static bool MMExt2_Core::PutMap(const string& cli, const string& id, const char& typ, map<string, T> &mapToStore, const T& val) {
-  if (!Delete(cli, id, typ)) return false;
-  m_types[id] = typ;
-  mapToStore[id] = val;
-  return Log(cli, "P", true, id);
-}
-
-bool MMExt2_Core::Put(const string& cli, const string& id, const bool& val)      { return PutMap<bool>(     cli, id, 'b', m_bools,      val); }
-bool MMExt2_Core::Put(const string& cli, const string& id, const int& val)       { return PutMap<int>(      cli, id, 'i', m_ints,       val); }
-bool MMExt2_Core::Put(const string& cli, const string& id, const double& val)    { return PutMap<double>(   cli, id, 'd', m_doubles,    val); }
-bool MMExt2_Core::Put(const string& cli, const string& id, const string& val)    { return PutMap<string>(   cli, id, 's', m_strings,    val); }
-bool MMExt2_Core::Put(const string& cli, const string& id, const VECTOR3& val)   { return PutMap<VECTOR3>(  cli, id, 'v', m_VECTOR3s,   val); }
-bool MMExt2_Core::Put(const string& cli, const string& id, const MATRIX3& val)   { return PutMap<MATRIX3>(  cli, id, '3', m_MATRIX3s,   val); }
-bool MMExt2_Core::Put(const string& cli, const string& id, const MATRIX4& val)   { return PutMap<MATRIX4>(  cli, id, '4', m_MATRIX4s,   val); }
-
-bool MMExt2_Core::Put(const string& cli, const string& id, const OBJHANDLE& val) {
-  if (!ValidateObjHandle(cli, id, val)) return false;
-  return PutMap<OBJHANDLE>(cli, id, 'o', m_OBJHANDLEs, val);
-}
-
-bool MMExt2_Core::Put(const string& cli, const string& id, const MMStruct* val)  {
-  if (!Delete(cli, id, 'x')) return false;
-  m_types[id] = 'x';
-  m_MMStructs[id] = val;
-  return Log(cli, "P", true, id);
-}
-
-bool MMExt2_Core::Put(const string& cli, const string& id, const EnjoLib::ModuleMessagingExtBase* val) {
-  if (!Delete(cli, id, 'y')) return false;
-  m_types[id] = 'y';
-  m_MMBases[id] = val;
-  return Log(cli, "P", true, id);
-}
-
-bool MMExt2_Core::Get(const string& cli, const string& id, int* val)             { return SearchMap<int>(      cli, id, m_ints,       val); }
-bool MMExt2_Core::Get(const string& cli, const string& id, bool* val)            { return SearchMap<bool>(     cli, id, m_bools,      val); }
-bool MMExt2_Core::Get(const string& cli, const string& id, double* val)          { return SearchMap<double>(   cli, id, m_doubles,    val); }
-bool MMExt2_Core::Get(const string& cli, const string& id, string* val)          { return SearchMap<string>(   cli, id, m_strings,    val); }
-bool MMExt2_Core::Get(const string& cli, const string& id, VECTOR3* val)         { return SearchMap<VECTOR3>(  cli, id, m_VECTOR3s,   val); }
-bool MMExt2_Core::Get(const string& cli, const string& id, MATRIX3* val)         { return SearchMap<MATRIX3>(  cli, id, m_MATRIX3s,   val); }
-bool MMExt2_Core::Get(const string& cli, const string& id, MATRIX4* val)         { return SearchMap<MATRIX4>(  cli, id, m_MATRIX4s,   val); }
-
-bool MMExt2_Core::Get(const string& cli, const string& id, OBJHANDLE* val){
-  bool ret = SearchMap<OBJHANDLE>(cli, id, m_OBJHANDLEs, val);
+bool MMExt2_Core::PutSlot(const MMKey& key, const char& typ, const T& val) {
+  unsigned long long t0 = StatBegin();
+  Entry* e = _Entry(key);
+  if (!e) return Stat("{unresolved}", MMSTAT_PUT, t0, false, 0, key.h);
+  char old;
+  bool chg = false;
+  {
+    Shard& sh = _Shard(e->hash);
+    unique_lock<shared_timed_mutex> wr(sh.lock);
+    if (e->dead.load(memory_order_relaxed)) {
+      wr.unlock();
+      return Stat(e->mod->c_str(), MMSTAT_PUT, t0, false, 0, key.h);
+    }
+    old = e->typ;
+    if (old != 'x' && old != 'y') {   // MMStruct and MMBase pointers are never replaced or deleted
+      chg = (old != typ || !Holds(*e, val));
+      if (chg) {                      // an unchanged value is left alone: no reader retries, and no notifications
+        if (old == 's' && typ != 's') Clear(sh, *e);
+        if (old == 'o') ObjUnlink(sh, key.h, e->val.o);
+        SeqBegin(*e);
+        e->typ = typ;
+        Store(sh, *e, val);
+        SeqEnd(*e);
+        if (typ == 'o') ObjLink(sh, key.h, e->val.o);
+      }
+      // recorded under the shard lock, so the sequence numbers of a key's records follow the order its writes landed
+      if (m_recOn.load(memory_order_relaxed)) RecPut(key, *e, typ, val);
+    }
+  }
+  if (old == 'x' || old == 'y') return Stat(e->mod->c_str(), MMSTAT_PUT, t0, Log(e->mod->c_str(), 'D', false, key), 0, key.h);
+  if (old != '\0' && old != typ) Log(e->mod->c_str(), 'D', true, key);
+  if (chg) Notify(key, *e, typ);
+  return Stat(e->mod->c_str(), MMSTAT_PUT, t0, Log(e->mod->c_str(), 'P', true, key), _Bytes(val), key.h);
+}
+
+bool MMExt2_Core::Put(const MMKey& key, const bool& val)                        { return PutSlot<bool>(     key, 'b', val); }
+bool MMExt2_Core::Put(const MMKey& key, const int& val)                         { return PutSlot<int>(      key, 'i', val); }
+bool MMExt2_Core::Put(const MMKey& key, const double& val)                      { return PutSlot<double>(   key, 'd', val); }
+bool MMExt2_Core::Put(const MMKey& key, const char* val)                        { return PutSlot<const char*>(key, 's', val); }
+bool MMExt2_Core::Put(const MMKey& key, const VECTOR3& val)                     { return PutSlot<VECTOR3>(  key, 'v', val); }
+bool MMExt2_Core::Put(const MMKey& key, const MATRIX3& val)                     { return PutSlot<MATRIX3>(  key, '3', val); }
+bool MMExt2_Core::Put(const MMKey& key, const MATRIX4& val)                     { return PutSlot<MATRIX4>(  key, '4', val); }
+bool MMExt2_Core::Put(const MMKey& key, const MMStruct* val)                    { return PutSlot<const MMStruct*>(key, 'x', val); }
+bool MMExt2_Core::Put(const MMKey& key, const EnjoLib::ModuleMessagingExtBase* val)
+                                                                                { return PutSlot<const EnjoLib::ModuleMessagingExtBase*>(key, 'y', val); }
+
+bool MMExt2_Core::Put(const MMKey& key, const OBJHANDLE& val) {
+  if (!ValidateObjHandle(key, val)) {  // always checked: this is input validation, not a liveness check
+    const Entry* e = _Entry(key);
+    return Stat(e ? e->mod->c_str() : "{unresolved}", MMSTAT_PUT, 0, false, 0, key.h);
+  }
+  return PutSlot<OBJHANDLE>(key, 'o', val);
+}
+
+bool MMExt2_Core::Get(const char* cli, const MMKey& key, int* val)            { return GetSlot<int>(      cli, key, 'i', val); }
+bool MMExt2_Core::Get(const char* cli, const MMKey& key, bool* val)           { return GetSlot<bool>(     cli, key, 'b', val); }
+bool MMExt2_Core::Get(const char* cli, const MMKey& key, double* val)         { return GetSlot<double>(   cli, key, 'd', val); }
+bool MMExt2_Core::Get(const char* cli, const MMKey& key, VECTOR3* val)        { return GetSlot<VECTOR3>(  cli, key, 'v', val); }
+bool MMExt2_Core::Get(const char* cli, const MMKey& key, MATRIX3* val)        { return GetSlot<MATRIX3>(  cli, key, '3', val); }
+bool MMExt2_Core::Get(const char* cli, const MMKey& key, MATRIX4* val)        { return GetSlot<MATRIX4>(  cli, key, '4', val); }
+bool MMExt2_Core::Get(const char* cli, const MMKey& key, const MMStruct** val){ return GetSlot<const MMStruct*>(cli, key, 'x', val); }
+bool MMExt2_Core::Get(const char* cli, const MMKey& key, const EnjoLib::ModuleMessagingExtBase** val)
+                                                                                { return GetSlot<const EnjoLib::ModuleMessagingExtBase*>(cli, key, 'y', val); }
+
+bool MMExt2_Core::Get(const char* cli, const MMKey& key, OBJHANDLE* val){
+  bool ret = GetSlot<OBJHANDLE>(cli, key, 'o', val);
   if (!ret) return false;
-  return ValidateObjHandle(cli, id, *val);
+  return Live(key, *val);
 }
 
-bool MMExt2_Core::ValidateObjHandle(const string& cli, const string& id, const OBJHANDLE obj) {
-  return (ObjType("", id, obj) != OBJTP_INVALID);
+bool MMExt2_Core::GetIfChanged(const char* cli, const MMKey& key, int* val, unsigned int* gen)      { return GetSlot<int>(      cli, key, 'i', val, gen); }
+bool MMExt2_Core::GetIfChanged(const char* cli, const MMKey& key, bool* val, unsigned int* gen)     { return GetSlot<bool>(     cli, key, 'b', val, gen); }
+bool MMExt2_Core::GetIfChanged(const char* cli, const MMKey& key, double* val, unsigned int* gen)   { return GetSlot<double>(   cli, key, 'd', val, gen); }
+bool MMExt2_Core::GetIfChanged(const char* cli, const MMKey& key, VECTOR3* val, unsigned int* gen)  { return GetSlot<VECTOR3>(  cli, key, 'v', val, gen); }
+bool MMExt2_Core::GetIfChanged(const char* cli, const MMKey& key, MATRIX3* val, unsigned int* gen)  { return GetSlot<MATRIX3>(  cli, key, '3', val, gen); }
+bool MMExt2_Core::GetIfChanged(const char* cli, const MMKey& key, MATRIX4* val, unsigned int* gen)  { return GetSlot<MATRIX4>(  cli, key, '4', val, gen); }
+
+bool MMExt2_Core::GetIfChanged(const char* cli, const MMKey& key, OBJHANDLE* val, unsigned int* gen) {
+  if (!GetSlot<OBJHANDLE>(cli, key, 'o', val, gen)) return false;
+  return Live(key, *val);
 }
 
-int MMExt2_Core::ObjType(const string& cli, const string& id, const OBJHANDLE& val) {
-  int obj_type = _ObjType(val);
-  if (obj_type == OBJTP_INVALID) Delete("{core}", id, '\0'); // Expunge bad objects from the core
-  if (cli!="") Log(cli, "T", (obj_type == OBJTP_INVALID), id);
-  return obj_type;
+bool MMExt2_Core::GetRef(const char* cli, const MMKey& key, const char** val, size_t* len, unsigned int* gen) {
+  unsigned long long t0 = StatBegin();
+  Entry* e = _Entry(key);
+  if (!e) return Stat(cli, MMSTAT_GET, t0, false, 0, key.h);
+  if (gen && (e->seq.load(memory_order_acquire) >> 1) == *gen) return Stat(cli, MMSTAT_GET, t0, false, 0, key.h);
+  bool ok;
+  {
+    shared_lock<shared_timed_mutex> rd(_Shard(e->hash).lock);
+    ok = (e->typ == 's');
+    if (ok) {
+      *val = _Str(*e);
+      *len = e->str.n;
+    }
+    if (gen) *gen = e->seq.load(memory_order_relaxed) >> 1;
+  }
+  return Stat(cli, MMSTAT_GET, t0, Log(cli, 'G', ok, key), 0, key.h);  // nothing copied
+}
+
+// A string that does not fit leaves the generation where it was, so the retry with a bigger buffer still copies it
+bool MMExt2_Core::GetCopy(const char* cli, const MMKey& key, char* val, size_t* len, unsigned int* gen) {
+  unsigned long long t0 = StatBegin();
+  Entry* e = _Entry(key);
+  if (!e) return Stat(cli, MMSTAT_GET, t0, false, 0, key.h);
+  if (gen && (e->seq.load(memory_order_acquire) >> 1) == *gen) return Stat(cli, MMSTAT_GET, t0, false, 0, key.h);
+  bool ok, fit = true;
+  {
+    shared_lock<shared_timed_mutex> rd(_Shard(e->hash).lock);
+    ok = (e->typ == 's');
+    if (ok) {
+      size_t n = e->str.n + 1;
+      fit = (n <= *len);
+      if (fit) memcpy(val, _Str(*e), n);
+      *len = n;
+    }
+    if (gen && fit) *gen = e->seq.load(memory_order_relaxed) >> 1;
+  }
+  return Stat(cli, MMSTAT_GET, t0, Log(cli, 'G', ok, key), (ok && fit) ? *len : 0, key.h);
+}
+
+bool MMExt2_Core::GetBatch(const char* cli, MMBatchItem* items, const size_t n) {
+  bool all = true;
+  for (size_t i = 0; i < n; i++) {
+    MMBatchItem& it = items[i];
+    it.ok = false;
+    if (!it.key.IsValid() && (!it.mod || !it.var || !LookupKey(cli, 'G', it.mod, it.var, it.ohv, &it.key))) { // a read never adds a key
+      all = false;
+      continue;
+    }
+    switch (it.typ) {
+    case 'b':  it.ok = Get(cli, it.key, static_cast<bool*>(it.val));       break;
+    case 'i':  it.ok = Get(cli, it.key, static_cast<int*>(it.val));        break;
+    case 'd':  it.ok = Get(cli, it.key, static_cast<double*>(it.val));     break;
+    case 'v':  it.ok = Get(cli, it.key, static_cast<VECTOR3*>(it.val));    break;
+    case '3':  it.ok = Get(cli, it.key, static_cast<MATRIX3*>(it.val));    break;
+    case '4':  it.ok = Get(cli, it.key, static_cast<MATRIX4*>(it.val));    break;
+    case 'o':  it.ok = Get(cli, it.key, static_cast<OBJHANDLE*>(it.val));  break;
+    }
+    all = all && it.ok;
+  }
+  return all;
+}
+
+bool MMExt2_Core::PutBatch(const string& cli, MMBatchItem* items, const size_t n) {
+  bool all = true;
+  for (size_t i = 0; i < n; i++) {
+    MMBatchItem& it = items[i];
+    it.ok = false;
+    if (!it.key.IsValid() && (!it.var || !Resolve(cli.c_str(), it.var, it.ohv, &it.key))) { // a Put is always to the caller's own module
+      all = false;
+      continue;
+    }
+    switch (it.typ) {
+    case 'b':  it.ok = Put(it.key, *static_cast<const bool*>(it.val));       break;
+    case 'i':  it.ok = Put(it.key, *static_cast<const int*>(it.val));        break;
+    case 'd':  it.ok = Put(it.key, *static_cast<const double*>(it.val));     break;
+    case 'v':  it.ok = Put(it.key, *static_cast<const VECTOR3*>(it.val));    break;
+    case '3':  it.ok = Put(it.key, *static_cast<const MATRIX3*>(it.val));    break;
+    case '4':  it.ok = Put(it.key, *static_cast<const MATRIX4*>(it.val));    break;
+    case 'o':  it.ok = Put(it.key, *static_cast<const OBJHANDLE*>(it.val));  break;
+    }
+    all = all && it.ok;
+  }
+  return all;
+}
+
+bool MMExt2_Core::ValidateObjHandle(const MMKey& key, const OBJHANDLE obj) {
+  return (ObjType("", key, obj) != OBJTP_INVALID);
+}
+
+// Liveness of a stored handle. With vessel events on, deleted vessels have already been purged, so there is no probe.
+bool MMExt2_Core::Live(const MMKey& key, const OBJHANDLE obj) {
+  if (m_vesEvents.load(memory_order_relaxed)) return true;
+  return ValidateObjHandle(key, obj);
+}
+
+bool MMExt2_Core::VesselEvents(const string& cli, const bool on) {
+  lock_guard<mutex> lk(m_vesLock);
+  if (on) {
+    m_vesClis.insert(cli);
+  } else {
+    m_vesClis.erase(cli);
+  }
+  m_vesEvents.store(!m_vesClis.empty(), memory_order_relaxed);
+  return true;
 }
 
+// Clears a key outright, MMStruct and MMBase included, as its vessel has gone. Returns whether it held a value.
+bool MMExt2_Core::Purge(const MMKey& key) {
+  Entry* e = _Entry(key);
+  if (!e) return false;  // the session was reset under us
+  char old;
+  {
+    Shard& sh = _Shard(e->hash);
+    unique_lock<shared_timed_mutex> wr(sh.lock);
+    old = e->typ;
+    if (old != '\0') {
+      if (old == 'o') ObjUnlink(sh, key.h, e->val.o);
+      SeqBegin(*e);
+      e->typ = '\0';
+      Clear(sh, *e);
+      SeqEnd(*e);
+    }
+  }
+  if (old == '\0') return false;
+  Notify(key, *e, '\0');
+  Log("{core}", 'D', true, key);
+  return true;
+}
+
+// Takes h out of a module or variable index list, and drops the list once it is empty
+template<class K> inline void _Unindex(unordered_map<K, vector<unsigned int>>& index, const K& name, const unsigned int h) {
+  typename unordered_map<K, vector<unsigned int>>::iterator it = index.find(name);
+  if (it == index.end()) return;
+  vector<unsigned int>& list = it->second;
+  vector<unsigned int>::iterator at = lower_bound(list.begin(), list.end(), h);
+  if (at != list.end() && *at == h) list.erase(at);
+  if (list.empty()) index.erase(it);
+}
 
-bool MMExt2_Core::Get(const string& cli, const string& id, const MMStruct** val) { return SearchMap<const MMStruct *>(cli, id, m_MMStructs, val); }
-bool MMExt2_Core::Get(const string& cli, const string& id, const EnjoLib::ModuleMessagingExtBase** val) { return SearchMap<const EnjoLib::ModuleMessagingExtBase *>(cli, id, m_MMBases, val); }
+// One sweep of the vessel index clears every key of the vessel, then the stored handle values pointing at it go too.
+// The vessel's keys leave the Find indexes, and are only indexed again if a new vessel on the same handle resolves them.
+bool MMExt2_Core::VesselDeleted(const OBJHANDLE ohv) {
+  if (!ohv) return false;
+  m_typeGen.fetch_add(1, memory_order_release);
+  HandleList keys;
+  MMKey key;
+  {
+    unique_lock<shared_timed_mutex> ix(m_index);
+    unordered_map<OBJHANDLE, HandleList>::iterator it = m_byVes.find(ohv);
+    if (it != m_byVes.end()) {
+      keys.swap(it->second);
+      m_byVes.erase(it);
+    }
+    for (unsigned int h : keys) {
+      key.h = h;
+      Entry* e = _Entry(key);
+      if (!e) continue;  // unless the session was reset under us
+      e->dead.store(true, memory_order_release);
+      _Unindex(m_byMod, *e->mod, h);
+      _Unindex(m_byVar, string(e->var), h);
+      e->indexed.store(false, memory_order_release);
+    }
+  }
+  for (unsigned int h : keys) {
+    key.h = h;
+    Purge(key);
+  }
+  keys.clear();
+  for (Shard& sh : m_shards) {
+    shared_lock<shared_timed_mutex> rd(sh.lock);
+    unordered_map<OBJHANDLE, vector<unsigned int>>::const_iterator it = sh.objs.find(ohv);
+    if (it != sh.objs.end()) keys.insert(keys.end(), it->second.begin(), it->second.end());
+  }
+  for (unsigned int h : keys) {
+    key.h = h;
+    if (_Entry(key)) Purge(key);  // unless the session was reset under us
+  }
+  return true;
+}
 
-bool MMExt2_Core::Delete(const string& cli, const string& id, const char& c) {
-  if (id.length() == 0) return false;
-  if (m_types.count(id)) {
-    if (m_types[id] == 'x' || m_types[id] == 'y') return Log(cli, "D", false, id);
-    if (m_types[id] == c) return true;
-    if (!DeleteType(id, m_types[id])) return false;
-    m_types.erase(id);
-    return Log(cli, "D", true, id);
+// Object type of a handle, probed at most once per frame per thread. The same few vessel handles are checked over and
+// over in a frame, and a vessel can only go away between frames (or through VesselDeleted, which moves m_typeGen on).
+int MMExt2_Core::HandleType(const OBJHANDLE h) {
+  TypeMemo& m = m_typeMemo[(reinterpret_cast<size_t>(h) >> 4) & (TYPE_MEMO - 1)];
+  unsigned int frame = m_frame.load(memory_order_relaxed);
+  unsigned int gen = m_typeGen.load(memory_order_acquire);
+  if (frame && m.h == h && m.frame == frame && m.gen == gen) {
+    m_typeHits.fetch_add(1, memory_order_relaxed);
+    return m.typ;
   }
+  m_typeMisses.fetch_add(1, memory_order_relaxed);
+  m.h = h;
+  m.frame = frame;
+  m.gen = gen;
+  m.typ = _ObjType(h);
+  return m.typ;
+}
+
+bool MMExt2_Core::ObjCacheStats(unsigned long long* hits, unsigned long long* misses) {
+  *hits = m_typeHits.load(memory_order_relaxed);
+  *misses = m_typeMisses.load(memory_order_relaxed);
   return true;
 }
 
-bool MMExt2_Core::DeleteType(const string &id, const char type) {
-  bool delFound = false;
-  switch (type) {
-  case 'i':    delFound = SearchMapDelete<int>(id, m_ints);              break;
-  case 'b':    delFound = SearchMapDelete<bool>(id, m_bools);            break;
-  case 'd':    delFound = SearchMapDelete<double>(id, m_doubles);        break;
-  case 's':    delFound = SearchMapDelete<string>(id, m_strings);        break;
-  case 'v':    delFound = SearchMapDelete<VECTOR3>(id, m_VECTOR3s);      break;
-  case 'o':    delFound = SearchMapDelete<OBJHANDLE>(id, m_OBJHANDLEs);  break;
-  case '3':    delFound = SearchMapDelete<MATRIX3>(id, m_MATRIX3s);      break;
-  case '4':    delFound = SearchMapDelete<MATRIX4>(id, m_MATRIX4s);      break;
+// Bytes held by the store against bytes actually in use: entry blocks against live entries, shard tables against
+// occupied slots, and the name arena and string pools against what has been handed out of them.
+bool MMExt2_Core::MemStats(size_t* reserved, size_t* used) {
+  size_t r = 0, u = 0;
+  for (auto& sh : m_shards) {
+    shared_lock<shared_timed_mutex> rd(sh.lock);
+    r += sh.slots.capacity() * sizeof(Slot) + sh.strs.arena.reserved + sh.strs.bigBytes;
+    u += sh.count * sizeof(Slot) + sh.strs.used;
+  }
+  {
+    lock_guard<mutex> lk(m_grow);
+    unsigned int n = m_count.load(memory_order_relaxed);
+    r += ((n + BLOCK_SIZE - 1) >> BLOCK_SHIFT) * BLOCK_SIZE * sizeof(Entry) + m_names.reserved;
+    u += n * sizeof(Entry) + m_names.used;
   }
-  return delFound;
+  *reserved = r;
+  *used = u;
+  return true;
 }
 
-bool MMExt2_Core::Log(const string& cli, const string& act, const bool& res, const string& id) {
-  string sohv, ves, mod, var;
-  OBJHANDLE ohv;
-  string s = (id == ""? string() + "00000000" + m_token + "*" + m_token + "*" : id);
-
-  istringstream is(s);
-  getline(is, sohv, m_token);
-  int ret = sscanf(sohv.c_str(), "%p", &ohv);
-  if (ret != 1) return false;
-  getline(is, mod, m_token);
-  getline(is, var, m_token);
-  if (!ohv) {
-    ves = "*";
+// End of a simulation session: every key, value and Find index goes, and the memory behind them is handed back in a
+// few large frees rather than one per key. Subscriptions tied to a vessel go too; the others stay, with nothing pending.
+// Keys resolved before the reset are refused afterwards, so clients resolve again. Borrowed strings and names from
+// before are gone, so only call this when no other thread can be inside MMExt2, e.g. from clbkSimulationEnd.
+bool MMExt2_Core::ResetSession() {
+  HotDump();
+  {
+    lock_guard<mutex> lk(m_hotLock);
+    for (HotTable* t : m_hotTables) {
+      lock_guard<mutex> lt(t->lock);
+      t->slots.clear();
+      t->ixs.clear();
+    }
+    m_hotLeft.clear();
+    m_hotLeftFrom = -1.0;
+  }
+  {
+    unique_lock<shared_timed_mutex> ix(m_index);
+    unique_lock<shared_timed_mutex> shards[SHARD_COUNT];
+    for (int i = 0; i < SHARD_COUNT; i++) shards[i] = unique_lock<shared_timed_mutex>(m_shards[i].lock);
+    lock_guard<mutex> lk(m_grow);
+    unsigned int n = m_count.load(memory_order_relaxed);
+    m_session.store((m_session.load(memory_order_relaxed) + 1) & (0xFFFFFFFFu >> INDEX_BITS), memory_order_relaxed);
+    m_count.store(0, memory_order_release);
+    for (unsigned int b = 0; b < ((n + BLOCK_SIZE - 1) >> BLOCK_SHIFT); b++) m_blocks[b].reset();
+    m_names.Release();
+    for (auto& sh : m_shards) {
+      vector<Slot>().swap(sh.slots);
+      sh.count = 0;
+      sh.strs.Release();
+      sh.objs.clear();
+    }
+    m_byMod.clear();
+    m_byVar.clear();
+    m_byVes.clear();
+  }
+  {
+    unique_lock<shared_timed_mutex> wr(m_subLock);
+    m_subByKey.clear();
+    m_subByMod.clear();
+    m_subByVar.clear();
+    m_subByVes.clear();
+    m_subAll.clear();
+    for (map<unsigned int, shared_ptr<Sub>>::iterator it = m_subs.begin(); it != m_subs.end();) {
+      if (it->second->ohv) {
+        it->second->retired.store(true, memory_order_release);
+        it = m_subs.erase(it);
+        continue;
+      }
+      {
+        lock_guard<mutex> lk(it->second->pendLock);
+        it->second->pend.clear();
+        it->second->pendSet.clear();
+      }
+      SubIndex(it->second, MMKey());
+      ++it;
+    }
+    m_subCount.store(static_cast<unsigned int>(m_subs.size()), memory_order_relaxed);
+  }
+  bool ok = ResetLog();
+  unique_lock<shared_timed_mutex> wr(m_qryLock);
+  m_qrys.clear();
+  m_qryIxs.clear();
+  return ok;
+}
+
+// Snapshot file, for checkpointing the store alongside a scenario. All fields are little endian with no padding, so the
+// file reads the same on any platform:
+//   header  "MMX2SNAP", u32 version, u32 record count
+//   record  u8 type char, u8 0, u16 module length, u16 variable length, u16 vessel name length, u32 value length,
+//           then the module, variable and vessel name characters (no NULs), then the value
+// Values: 'b' one byte 0 / 1, 'i' int32, 'd' double, 'v' / '3' / '4' 3, 9 or 16 doubles (each as the u64 of its IEEE
+// bits), 's' the characters, and 'o' the name of the object it points at. Vessels go by name, as handles mean nothing
+// to the next session. MMStruct and MMBase pointers are left out, as are keys whose vessel (or stored object) has gone.
+// Snapshot builds the file in memory and writes it with one fwrite; only Restore maps the file, to read it in place.
+
+inline void _Out(vector<char>& out, const void* p, const size_t n) {
+  out.insert(out.end(), static_cast<const char*>(p), static_cast<const char*>(p) + n);
+}
+
+template<class T> inline void _OutInt(vector<char>& out, const T v) {
+  for (size_t i = 0; i < sizeof(T); i++) out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+template<class T> inline bool _InInt(const char** p, const char* end, T* v) {
+  if (static_cast<size_t>(end - *p) < sizeof(T)) return false;
+  *v = 0;
+  for (size_t i = 0; i < sizeof(T); i++) *v |= static_cast<T>(static_cast<unsigned char>((*p)[i])) << (8 * i);
+  *p += sizeof(T);
+  return true;
+}
+
+// Doubles go out as the little endian u64 of their bits, n of them from the value at p
+inline void _OutDbl(vector<char>& out, const void* p, const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    unsigned long long u;
+    memcpy(&u, static_cast<const char*>(p) + i * sizeof(double), sizeof(u));
+    _OutInt(out, u);
+  }
+}
+
+inline void _InDbl(const char* v, const size_t n, void* p) {
+  for (size_t i = 0; i < n; i++) {
+    unsigned long long u;
+    const char* q = v + i * sizeof(u);
+    _InInt(&q, q + sizeof(u), &u);
+    memcpy(static_cast<char*>(p) + i * sizeof(double), &u, sizeof(u));
+  }
+}
+
+inline bool _InStr(const char** p, const char* end, const size_t n, string* s) {
+  if (static_cast<size_t>(end - *p) < n) return false;
+  s->assign(*p, n);
+  *p += n;
+  return true;
+}
+
+// Read-only mapping of a whole file
+class _MappedFile {
+public:
+  _MappedFile(const char* path) : data(NULL), size(0) {
+#ifdef _WIN32
+    m_map = NULL;
+    m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(m_file, &sz) || sz.QuadPart == 0) return;
+    if (!(m_map = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL))) return;
+    data = static_cast<const char*>(MapViewOfFile(m_map, FILE_MAP_READ, 0, 0, 0));
+    if (data) size = static_cast<size_t>(sz.QuadPart);
+#else
+    struct stat st;
+    if ((m_fd = open(path, O_RDONLY)) < 0) return;
+    if (fstat(m_fd, &st) != 0 || st.st_size == 0) return;
+    void* p = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (p == MAP_FAILED) return;
+    data = static_cast<const char*>(p);
+    size = static_cast<size_t>(st.st_size);
+#endif
+  }
+  ~_MappedFile() {
+#ifdef _WIN32
+    if (data) UnmapViewOfFile(data);
+    if (m_map) CloseHandle(m_map);
+    if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+#else
+    if (data) munmap(const_cast<char*>(data), size);
+    if (m_fd >= 0) close(m_fd);
+#endif
+  }
+  const char* data;
+  size_t size;
+private:
+#ifdef _WIN32
+  HANDLE m_file;
+  HANDLE m_map;
+#else
+  int m_fd;
+#endif
+};
+
+inline size_t _ValSize(const char typ) {
+  switch (typ) {
+  case 'b': return 1;
+  case 'i': return 4;
+  case 'd': return sizeof(double);
+  case 'v': return 3 * sizeof(double);
+  case '3': return 9 * sizeof(double);
+  case '4': return 16 * sizeof(double);
+  default:  return 0;
+  }
+}
+
+// Values are copied out one key at a time under its shard lock, and the file is written in one go at the end
+bool MMExt2_Core::Snapshot(const char* path) {
+  vector<char> out;
+  _Out(out, SNAP_MAGIC, 8);
+  _OutInt<unsigned int>(out, SNAP_VERSION);
+  size_t countAt = out.size();
+  _OutInt<unsigned int>(out, 0);
+  unsigned int recs = 0;
+  unsigned int n = m_count.load(memory_order_acquire);
+  char ves[256], obj[256];
+  for (unsigned int ix = 0; ix < n; ix++) {
+    MMKey key;
+    key.h = _Handle(ix);
+    Entry* e = _Entry(key);
+    if (!e || !e->ohv || e->dead.load(memory_order_acquire)) continue;
+    char typ;
+    Value val;
+    string str;
+    {
+      shared_lock<shared_timed_mutex> rd(_Shard(e->hash).lock);
+      typ = e->typ;
+      if (typ == 's') {
+        str.assign(_Str(*e), e->str.n);
+      } else {
+        val = e->val;
+      }
+    }
+    if (typ == '\0' || typ == 'x' || typ == 'y' || HandleType(e->ohv) != OBJTP_VESSEL) continue;
+    if (typ == 'o') {
+      if (HandleType(val.o) == OBJTP_INVALID) continue;
+      oapiGetObjectName(val.o, obj, sizeof(obj));
+      str = obj;
+    }
+    oapiGetObjectName(e->ohv, ves, sizeof(ves));
+    size_t lMod = e->mod->length(), lVar = strlen(e->var), lVes = strlen(ves);
+    if (lMod > 0xFFFF || lVar > 0xFFFF || str.length() > 0xFFFFFFFFu) continue;
+    out.push_back(typ);
+    out.push_back(0);
+    _OutInt<unsigned short>(out, static_cast<unsigned short>(lMod));
+    _OutInt<unsigned short>(out, static_cast<unsigned short>(lVar));
+    _OutInt<unsigned short>(out, static_cast<unsigned short>(lVes));
+    _OutInt<unsigned int>(out, static_cast<unsigned int>(typ == 's' || typ == 'o' ? str.length() : _ValSize(typ)));
+    _Out(out, e->mod->c_str(), lMod);
+    _Out(out, e->var, lVar);
+    _Out(out, ves, lVes);
+    switch (typ) {
+    case 'b': out.push_back(val.b ? 1 : 0); break;
+    case 'i': _OutInt<unsigned int>(out, static_cast<unsigned int>(val.i)); break;
+    case 's':
+    case 'o': _Out(out, str.c_str(), str.length()); break;
+    default:  _OutDbl(out, &val, _ValSize(typ) / sizeof(double)); break;
+    }
+    recs++;
+  }
+  for (size_t i = 0; i < 4; i++) out[countAt + i] = static_cast<char>((recs >> (8 * i)) & 0xFF);
+
+  FILE* f = fopen(path, "wb");
+  if (!f) return false;
+  bool ok = (fwrite(&out[0], 1, out.size(), f) == out.size());
+  return (fclose(f) == 0) && ok;
+}
+
+// Maps the file and Puts each record in turn, so subscribers hear about the restored values as usual. A record whose
+// vessel or stored object is not in this session is skipped. Returns false for a file that is not a snapshot, or is
+// cut short, though any records before the damage have been restored by then.
+bool MMExt2_Core::Restore(const char* path) {
+  _MappedFile f(path);
+  if (!f.data || f.size < 16 || memcmp(f.data, SNAP_MAGIC, 8)) return false;
+  const char* p = f.data + 8;
+  const char* end = f.data + f.size;
+  unsigned int ver, recs;
+  if (!_InInt(&p, end, &ver) || ver != SNAP_VERSION || !_InInt(&p, end, &recs)) return false;
+  string mod, var, ves, str;
+  for (unsigned int r = 0; r < recs; r++) {
+    unsigned char typ, pad;
+    unsigned short lMod, lVar, lVes;
+    unsigned int lVal;
+    if (!_InInt(&p, end, &typ) || !_InInt(&p, end, &pad) || !_InInt(&p, end, &lMod) || !_InInt(&p, end, &lVar) ||
+        !_InInt(&p, end, &lVes) || !_InInt(&p, end, &lVal)) return false;
+    if (!_InStr(&p, end, lMod, &mod) || !_InStr(&p, end, lVar, &var) || !_InStr(&p, end, lVes, &ves)) return false;
+    if (static_cast<size_t>(end - p) < lVal) return false;
+    const char* v = p;
+    p += lVal;
+    if (typ != 's' && typ != 'o' && lVal != _ValSize(typ)) continue;
+    OBJHANDLE ohv = (ves.empty() ? NULL : oapiGetVesselByName(&ves[0]));
+    MMKey key;
+    if (!ohv || !Resolve(mod.c_str(), var.c_str(), ohv, &key)) continue;
+    Value val;
+    switch (typ) {
+    case 'b': Put(key, v[0] != 0); break;
+    case 'i': {
+      const char* q = v;
+      unsigned int i;
+      if (!_InInt(&q, p, &i)) continue;
+      Put(key, static_cast<int>(i));
+      break;
+    }
+    case 'd': _InDbl(v, 1, &val.d); Put(key, val.d); break;
+    case 'v': _InDbl(v, 3, &val.v); Put(key, val.v); break;
+    case '3': _InDbl(v, 9, &val.m3); Put(key, val.m3); break;
+    case '4': _InDbl(v, 16, &val.m4); Put(key, val.m4); break;
+    case 's': str.assign(v, lVal); Put(key, str.c_str()); break;
+    case 'o': {
+      str.assign(v, lVal);
+      OBJHANDLE obj = (str.empty() ? NULL : oapiGetObjectByName(&str[0]));
+      if (obj) Put(key, obj);
+      break;
+    }
+    }
+  }
+  return true;
+}
+
+// Recording file, for replaying a session's traffic later: "MMX2STRM", u32 version, then blocks of u32 raw length, u32
+// packed length and the packed bytes (stored as they are when packing would not shrink them). Unpacked and joined up,
+// the blocks hold a run of records, each a u64 sequence number, double sim time, u32 key handle, type char and u32
+// value length, then the value, all in host byte order (little endian, on every platform Orbiter runs on).
+// Record types are those of the values, with '\0' for a delete, plus 'k' for the names of a key, written before the
+// first Put to it in each recording: u16 module, variable and vessel name lengths, then the three names. A string
+// value is its characters, an object value the object's name, and MMStruct and MMBase values are empty.
+// Records come out grouped by thread, not in sequence order, so Replay sorts them.
+
+// Byte-oriented LZ77 for the record blocks, in the style of LZ4: each token holds a literal run length and a match
+// length (4 bits each, with 255-runs of extension bytes), followed by the literals and a 16 bit match offset. The last
+// token carries literals only.
+inline void _PackLen(vector<char>* out, size_t n) {
+  for (; n >= 255; n -= 255) out->push_back(static_cast<char>(255));
+  out->push_back(static_cast<char>(n));
+}
+
+inline void _PackSeq(vector<char>* out, const char* lit, const size_t nLit, const size_t off, const size_t nMatch) {
+  size_t m = (nMatch ? nMatch - 4 : 0);
+  out->push_back(static_cast<char>(((nLit < 15 ? nLit : 15) << 4) | (m < 15 ? m : 15)));
+  if (nLit >= 15) _PackLen(out, nLit - 15);
+  out->insert(out->end(), lit, lit + nLit);
+  if (!nMatch) return;
+  out->push_back(static_cast<char>(off & 0xFF));
+  out->push_back(static_cast<char>(off >> 8));
+  if (m >= 15) _PackLen(out, m - 15);
+}
+
+inline void _Pack(const char* in, const size_t n, vector<char>* out) {
+  const unsigned int bits = 12;
+  vector<unsigned int> seen(1u << bits, 0);  // position + 1 of the last place each 4 byte hash was seen
+  size_t anchor = 0, i = 0;
+  out->clear();
+  while (i + 4 <= n) {
+    unsigned int quad;
+    memcpy(&quad, in + i, 4);
+    unsigned int slot = (quad * 2654435761u) >> (32 - bits);
+    size_t cand = seen[slot];
+    seen[slot] = static_cast<unsigned int>(i + 1);
+    if (cand && i - (cand - 1) <= 0xFFFF && !memcmp(in + cand - 1, in + i, 4)) {
+      size_t from = cand - 1, len = 4;
+      while (i + len < n && in[from + len] == in[i + len]) len++;
+      _PackSeq(out, in + anchor, i - anchor, i - from, len);
+      i += len;
+      anchor = i;
+    } else {
+      i++;
+    }
+  }
+  _PackSeq(out, in + anchor, n - anchor, 0, 0);
+}
+
+inline bool _UnpackLen(const unsigned char** p, const unsigned char* end, size_t* n) {
+  unsigned char b;
+  do {
+    if (*p >= end) return false;
+    b = *(*p)++;
+    *n += b;
+  } while (b == 255);
+  return true;
+}
+
+// Appends exactly raw bytes to out, or returns false for a damaged block
+inline bool _Unpack(const char* in, const size_t n, const size_t raw, vector<char>* out) {
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(in);
+  const unsigned char* end = p + n;
+  size_t base = out->size(), lim = base + raw;
+  while (p < end) {
+    unsigned char tok = *p++;
+    size_t nLit = tok >> 4, nMatch = tok & 15;
+    if (nLit == 15 && !_UnpackLen(&p, end, &nLit)) return false;
+    if (static_cast<size_t>(end - p) < nLit || lim - out->size() < nLit) return false;
+    out->insert(out->end(), p, p + nLit);
+    p += nLit;
+    if (p == end) break;
+    if (end - p < 2) return false;
+    size_t off = p[0] | (p[1] << 8);
+    p += 2;
+    if (nMatch == 15 && !_UnpackLen(&p, end, &nMatch)) return false;
+    nMatch += 4;
+    if (off == 0 || off > out->size() - base || lim - out->size() < nMatch) return false;
+    for (size_t from = out->size() - off, k = 0; k < nMatch; k++) out->push_back((*out)[from + k]);
+  }
+  return out->size() == lim;
+}
+
+MMExt2_Core::RecBuf::RecBuf() : woke(false), objEpoch(0), objGen(0) {
+  lock_guard<mutex> lk(m_recLock);
+  m_recBufs.push_back(this);
+}
+
+MMExt2_Core::RecBuf::~RecBuf() {
+  lock_guard<mutex> lk(m_recLock);
+  m_recLeft.insert(m_recLeft.end(), data.begin(), data.end());
+  m_recBufs.erase(find(m_recBufs.begin(), m_recBufs.end(), this));
+}
+
+// The hot path: one atomic increment and an uncontended lock, then the header and value bytes are copied onto the end
+// of this thread's buffer. The key's names go out the first time it is recorded.
+void MMExt2_Core::Rec(const MMKey& key, Entry& e, const char typ, const void* val, const size_t len) {
+  unsigned int epoch = m_recEpoch.load(memory_order_relaxed);
+  char ves[256];
+  size_t lMod = 0, lVar = 0, lVes = 0;
+  bool names = (e.rec.load(memory_order_relaxed) != epoch && e.rec.exchange(epoch) != epoch);
+  if (names) {
+    oapiGetObjectName(e.ohv, ves, sizeof(ves));
+    lMod = min<size_t>(e.mod->length(), 0xFFFF);
+    lVar = min<size_t>(strlen(e.var), 0xFFFF);
+    lVes = strlen(ves);
+  }
+  unsigned long long seq = m_recSeq.fetch_add(1, memory_order_relaxed);
+  double simt = oapiGetSimTime();
+  unsigned int n = static_cast<unsigned int>(len);
+  RecBuf& b = m_recLocal;
+  lock_guard<mutex> lk(b.lock);
+  size_t at = b.data.size();
+  if (names) {
+    unsigned int nNames = static_cast<unsigned int>(6 + lMod + lVar + lVes);
+    unsigned short l[3] = { static_cast<unsigned short>(lMod), static_cast<unsigned short>(lVar), static_cast<unsigned short>(lVes) };
+    b.data.resize(at + REC_HEAD + nNames);
+    char* p = &b.data[at];
+    memcpy(p, &seq, 8);
+    memcpy(p + 8, &simt, 8);
+    memcpy(p + 16, &key.h, 4);
+    p[20] = 'k';
+    memcpy(p + 21, &nNames, 4);
+    memcpy(p + REC_HEAD, l, 6);
+    memcpy(p + REC_HEAD + 6, e.mod->c_str(), lMod);
+    memcpy(p + REC_HEAD + 6 + lMod, e.var, lVar);
+    memcpy(p + REC_HEAD + 6 + lMod + lVar, ves, lVes);
+    at = b.data.size();
+  }
+  b.data.resize(at + REC_HEAD + n);
+  char* p = &b.data[at];
+  memcpy(p, &seq, 8);
+  memcpy(p + 8, &simt, 8);
+  memcpy(p + 16, &key.h, 4);
+  p[20] = typ;
+  memcpy(p + 21, &n, 4);
+  if (n) memcpy(p + REC_HEAD, val, n);
+  if (b.data.size() >= REC_FLUSH && !b.woke) {
+    b.woke = true;
+    m_recWake.notify_one();
+  }
+}
+
+// Gathers every thread's records and writes out the full blocks, or everything when all is set
+void MMExt2_Core::RecDrain(const bool all) {
+  vector<char> raw;
+  {
+    lock_guard<mutex> lk(m_recLock);
+    raw.swap(m_recLeft);
+    for (RecBuf* b : m_recBufs) {
+      lock_guard<mutex> lb(b->lock);
+      raw.insert(raw.end(), b->data.begin(), b->data.end());
+      b->data.clear();
+      b->woke = false;
+    }
+  }
+  lock_guard<mutex> wr(m_recWrite);
+  if (!m_recFile) return;
+  m_recBlock.insert(m_recBlock.end(), raw.begin(), raw.end());
+  size_t at = 0;
+  vector<char> packed;
+  while (m_recBlock.size() - at >= REC_BLOCK || (all && at < m_recBlock.size())) {
+    unsigned int n = static_cast<unsigned int>(min<size_t>(m_recBlock.size() - at, REC_BLOCK));
+    _Pack(&m_recBlock[at], n, &packed);
+    bool store = (packed.size() >= n);
+    unsigned int hdr[2] = { n, store ? n : static_cast<unsigned int>(packed.size()) };
+    fwrite(hdr, sizeof(hdr), 1, m_recFile);
+    fwrite(store ? &m_recBlock[at] : &packed[0], 1, hdr[1], m_recFile);
+    at += n;
+  }
+  m_recBlock.erase(m_recBlock.begin(), m_recBlock.begin() + at);
+  if (all) fflush(m_recFile);
+}
+
+void MMExt2_Core::RecThread() {
+  unique_lock<mutex> lk(m_recLock);
+  while (!m_recStop) {
+    m_recWake.wait_for(lk, chrono::milliseconds(REC_PERIOD));
+    lk.unlock();
+    RecDrain(false);
+    lk.lock();
+  }
+}
+
+bool MMExt2_Core::RecordStart(const char* path) {
+  lock_guard<mutex> ctl(m_recCtl);
+  {
+    lock_guard<mutex> wr(m_recWrite);
+    if (m_recFile) return false;
+    if (!(m_recFile = fopen(path, "wb"))) return false;
+    unsigned int ver = REC_VERSION;
+    fwrite(REC_MAGIC, 8, 1, m_recFile);
+    fwrite(&ver, sizeof(ver), 1, m_recFile);
+    m_recBlock.clear();
+  }
+  {
+    lock_guard<mutex> lk(m_recLock);   // drop anything left over from stragglers of the last recording
+    m_recLeft.clear();
+    for (RecBuf* b : m_recBufs) {
+      lock_guard<mutex> lb(b->lock);
+      b->data.clear();
+    }
+    m_recStop = false;
+  }
+  m_recEpoch.fetch_add(1);
+  m_recSeq.store(0);
+  m_recThread = thread(RecThread);
+  m_recOn.store(true);
+  return true;
+}
+
+bool MMExt2_Core::RecordStop() {
+  lock_guard<mutex> ctl(m_recCtl);
+  if (!m_recOn.exchange(false)) return false;
+  {
+    lock_guard<mutex> lk(m_recLock);
+    m_recStop = true;
+  }
+  m_recWake.notify_all();
+  if (m_recThread.joinable()) m_recThread.join();
+  RecDrain(true);
+  lock_guard<mutex> wr(m_recWrite);
+  bool ok = (fclose(m_recFile) == 0);
+  m_recFile = NULL;
+  return ok;
+}
+
+// Unpacks the whole recording, resolves the keys named in it, then Puts (or Deletes) every record in sequence order,
+// as fast as it will go. Keys on vessels not in this session are skipped. Returns false if the file is damaged.
+bool MMExt2_Core::Replay(const char* path) {
+  _MappedFile f(path);
+  if (!f.data || f.size < 12 || memcmp(f.data, REC_MAGIC, 8)) return false;
+  const char* p = f.data + 8;
+  const char* end = f.data + f.size;
+  unsigned int ver;
+  if (!_InInt(&p, end, &ver) || ver != REC_VERSION) return false;
+  vector<char> raw;
+  while (p < end) {
+    unsigned int n, packed;
+    if (!_InInt(&p, end, &n) || !_InInt(&p, end, &packed) || static_cast<size_t>(end - p) < packed) return false;
+    if (packed == n) {
+      raw.insert(raw.end(), p, p + n);
+    } else if (!_Unpack(p, packed, n, &raw)) {
+      return false;
+    }
+    p += packed;
+  }
+
+  struct RecKey {
+    MMKey key;
+    string mod;
+  };
+  struct Op {
+    unsigned long long seq;
+    size_t at;
+  };
+  unordered_map<unsigned int, RecKey> keys;
+  vector<Op> ops;
+  string mod, var, ves;
+  for (size_t at = 0; at < raw.size();) {
+    if (raw.size() - at < REC_HEAD) return false;
+    const char* r = &raw[at];
+    unsigned long long seq;
+    unsigned int h, len;
+    memcpy(&seq, r, 8);
+    memcpy(&h, r + 16, 4);
+    memcpy(&len, r + 21, 4);
+    if (raw.size() - at - REC_HEAD < len) return false;
+    if (r[20] == 'k') {
+      unsigned short l[3];
+      if (len < 6) return false;
+      memcpy(l, r + REC_HEAD, 6);
+      if (6u + l[0] + l[1] + l[2] != len) return false;
+      mod.assign(r + REC_HEAD + 6, l[0]);
+      var.assign(r + REC_HEAD + 6 + l[0], l[1]);
+      ves.assign(r + REC_HEAD + 6 + l[0] + l[1], l[2]);
+      RecKey& k = keys[h];
+      OBJHANDLE ohv = (ves.empty() ? NULL : oapiGetVesselByName(&ves[0]));
+      k.mod = mod;
+      if (!ohv || !Resolve(mod.c_str(), var.c_str(), ohv, &k.key)) k.key = MMKey();
+    } else {
+      Op op = { seq, at };
+      ops.push_back(op);
+    }
+    at += REC_HEAD + len;
+  }
+  sort(ops.begin(), ops.end(), [](const Op& a, const Op& b) { return a.seq < b.seq; });
+
+  string str;
+  for (const Op& op : ops) {
+    const char* r = &raw[op.at];
+    unsigned int h, len;
+    memcpy(&h, r + 16, 4);
+    memcpy(&len, r + 21, 4);
+    char typ = r[20];
+    const char* v = r + REC_HEAD;
+    unordered_map<unsigned int, RecKey>::const_iterator it = keys.find(h);
+    if (it == keys.end() || !it->second.key.IsValid()) continue;
+    const MMKey& key = it->second.key;
+    if (typ == '\0') {
+      Delete(it->second.mod, key);
+      continue;
+    }
+    if (typ != 's' && typ != 'o' && len != _ValSize(typ)) continue;
+    Value val;
+    switch (typ) {
+    case 'b': Put(key, v[0] != 0); break;
+    case 'i': memcpy(&val.i, v, len);  Put(key, val.i);  break;
+    case 'd': memcpy(&val.d, v, len);  Put(key, val.d);  break;
+    case 'v': memcpy(&val.v, v, len);  Put(key, val.v);  break;
+    case '3': memcpy(&val.m3, v, len); Put(key, val.m3); break;
+    case '4': memcpy(&val.m4, v, len); Put(key, val.m4); break;
+    case 's': str.assign(v, len); Put(key, str.c_str()); break;
+    case 'o': {
+      str.assign(v, len);
+      OBJHANDLE obj = (str.empty() ? NULL : oapiGetObjectByName(&str[0]));
+      if (obj) Put(key, obj);
+      break;
+    }
+    }
+  }
+  return true;
+}
+
+int MMExt2_Core::ObjType(const string& cli, const MMKey& key, const OBJHANDLE& val) {
+  int obj_type = HandleType(val);
+  if (obj_type == OBJTP_INVALID) Delete("{core}", key, '\0'); // Expunge bad objects from the core
+  if (cli != "" && _Entry(key)) Log(cli.c_str(), 'T', (obj_type == OBJTP_INVALID), key);
+  return obj_type;
+}
+
+bool MMExt2_Core::Delete(const string& cli, const MMKey& key, const char& c) {
+  unsigned long long t0 = StatBegin();
+  Entry* e = _Entry(key);
+  if (!e) return Stat(cli.c_str(), MMSTAT_DELETE, t0, false, 0, key.h);
+  char old;
+  {
+    Shard& sh = _Shard(e->hash);
+    unique_lock<shared_timed_mutex> wr(sh.lock);
+    old = e->typ;
+    if (old != '\0' && old != 'x' && old != 'y' && old != c) {
+      if (old == 'o') ObjUnlink(sh, key.h, e->val.o);
+      SeqBegin(*e);
+      e->typ = '\0';
+      SeqEnd(*e);
+      Clear(sh, *e);
+      if (m_recOn.load(memory_order_relaxed)) Rec(key, *e, '\0', NULL, 0);
+    }
+  }
+  if (old == '\0') return Stat(cli.c_str(), MMSTAT_DELETE, t0, true, 0, key.h);
+  if (old == 'x' || old == 'y') return Stat(cli.c_str(), MMSTAT_DELETE, t0, Log(cli.c_str(), 'D', false, key), 0, key.h);
+  if (old == c) return Stat(cli.c_str(), MMSTAT_DELETE, t0, true, 0, key.h);
+  Notify(key, *e, '\0');
+  return Stat(cli.c_str(), MMSTAT_DELETE, t0, Log(cli.c_str(), 'D', true, key), 0, key.h);
+}
+
+bool MMExt2_Core::Delete(const char* cli, const char* mod, const char* var, const OBJHANDLE ohv) {
+  if (!_ValidName(mod) || !_ValidName(var)) return Refused(cli, MMSTAT_DELETE);
+  if (ohv && !m_vesEvents.load(memory_order_relaxed) && HandleType(ohv) != OBJTP_VESSEL) return Refused(cli, MMSTAT_DELETE);
+  MMKey key;
+  key.h = Lookup(ohv, mod, var);
+  Entry* e = _Entry(key);
+  if (e && e->indexed.load(memory_order_acquire) && !e->dead.load(memory_order_acquire)) return Delete(string(cli), key);
+  return Stat(cli, MMSTAT_DELETE, StatBegin(), true, 0);
+}
+
+// Files a subscription under the most specific thing it names. Caller holds m_subLock exclusively.
+void MMExt2_Core::SubIndex(const shared_ptr<Sub>& s, const MMKey& key) {
+  if (key.IsValid()) {
+    m_subByKey[key.h].push_back(s);
+  } else if (s->mod != "*") {
+    m_subByMod[s->mod].push_back(s);
+  } else if (s->var != "*") {
+    m_subByVar[s->var].push_back(s);
+  } else if (s->ohv) {
+    m_subByVes[s->ohv].push_back(s);
   } else {
-    if (!_IsVessel(ohv)) return false;
-    ves = oapiGetVesselInterface(ohv)->GetName();
+    m_subAll.push_back(s);
+  }
+}
+
+// Picks the subscriptions in subs that take a change to key. Caller holds m_subLock shared.
+void MMExt2_Core::SubMatch(const SubList& subs, const MMKey& key, const Entry& e, vector<Note>* now) {
+  for (const auto& s : subs) {
+    if (!(((s->mod == "*") || (s->mod == *e.mod)) && ((s->var == "*") || (s->var == e.var)) && ((s->ohv == NULL) || (s->ohv == e.ohv)))) continue;
+    if (s->skp && s->cli == *e.mod) continue;
+    if (!s->frame) {
+      SubHold(s, key.h, now);
+      continue;
+    }
+    lock_guard<mutex> lk(s->pendLock);
+    if (s->pendSet.insert(key.h).second) s->pend.push_back(key.h);
+  }
+}
+
+// Queues a callback, counted against the subscription while m_subLock is still held, so Unsubscribe cannot miss it
+void MMExt2_Core::SubHold(const shared_ptr<Sub>& s, const unsigned int h, vector<Note>* now) {
+  s->calls.fetch_add(1, memory_order_relaxed);
+  m_subHeld.push_back(s.get());
+  Note n = { s, h };
+  now->push_back(n);
+}
+
+void MMExt2_Core::SubCall(const Note& n, const char* mod, const char* var, const OBJHANDLE ohv, const char typ) {
+  MMKey key;
+  key.h = n.h;
+  if (!n.sub->retired.load(memory_order_acquire)) n.sub->fn(mod, var, ohv, key, typ, n.sub->ctx);
+  SubDone(n);
+}
+
+void MMExt2_Core::SubDone(const Note& n) {
+  m_subHeld.erase(find(m_subHeld.rbegin(), m_subHeld.rend(), n.sub.get()).base() - 1);
+  n.sub->calls.fetch_sub(1, memory_order_release);
+}
+
+// Fans a change out to the subscriptions that match it. Sync callbacks are made once the lock is released, so they
+// are free to Put, Get or (un)subscribe themselves.
+void MMExt2_Core::Notify(const MMKey& key, const Entry& e, const char typ) {
+  if (m_subCount.load(memory_order_relaxed) == 0) return;
+  vector<Note> now;
+  {
+    shared_lock<shared_timed_mutex> rd(m_subLock);
+    unordered_map<unsigned int, SubList>::const_iterator k = m_subByKey.find(key.h);
+    if (k != m_subByKey.end()) SubMatch(k->second, key, e, &now);
+    if (!m_subByMod.empty()) {
+      unordered_map<string, SubList>::const_iterator m = m_subByMod.find(*e.mod);
+      if (m != m_subByMod.end()) SubMatch(m->second, key, e, &now);
+    }
+    if (!m_subByVar.empty()) {
+      unordered_map<string, SubList>::const_iterator v = m_subByVar.find(e.var);
+      if (v != m_subByVar.end()) SubMatch(v->second, key, e, &now);
+    }
+    if (!m_subByVes.empty()) {
+      unordered_map<OBJHANDLE, SubList>::const_iterator o = m_subByVes.find(e.ohv);
+      if (o != m_subByVes.end()) SubMatch(o->second, key, e, &now);
+    }
+    SubMatch(m_subAll, key, e, &now);
+  }
+  for (const auto& n : now) SubCall(n, e.mod->c_str(), e.var, e.ohv, typ);
+}
+
+bool MMExt2_Core::Subscribe(unsigned int* id, const string& cli, const string& mod, const string& var, const OBJHANDLE ohv, MMNotifyFunc fn, void* ctx, const int mode, bool skp) {
+  *id = 0;
+  if (!fn || (mode != MMNOTIFY_SYNC && mode != MMNOTIFY_FRAME)) return false;
+  if (!_ValidName(mod.c_str()) || !_ValidName(var.c_str())) return false;
+  MMKey key;
+  if (mod != "*" && var != "*" && ohv && !Resolve(mod.c_str(), var.c_str(), ohv, &key)) return Log(cli.c_str(), 'S', false, ohv, mod.c_str(), var.c_str());
+  shared_ptr<Sub> s(new Sub);
+  s->cli = cli;
+  s->mod = mod;
+  s->var = var;
+  s->ohv = ohv;
+  s->skp = skp;
+  s->frame = (mode == MMNOTIFY_FRAME);
+  s->fn = fn;
+  s->ctx = ctx;
+  {
+    unique_lock<shared_timed_mutex> wr(m_subLock);
+    s->id = *id = ++m_subNext;
+    SubIndex(s, key);
+    m_subs[s->id] = s;
+    m_subCount++;
+  }
+  return Log(cli.c_str(), 'S', true, ohv, mod.c_str(), var.c_str());
+}
+
+// Waits for callbacks already picked up on other threads to return. One on this thread (the subscription unsubscribing
+// itself, say) cannot be waited for, and is skipped if it has not been made yet. Two callbacks on different threads
+// must not unsubscribe each other's subscriptions, as each would wait on the other.
+bool MMExt2_Core::Unsubscribe(const string& cli, const unsigned int id) {
+  shared_ptr<Sub> s;
+  {
+    unique_lock<shared_timed_mutex> wr(m_subLock);
+    map<unsigned int, shared_ptr<Sub>>::iterator it = m_subs.find(id);
+    if (it == m_subs.end() || it->second->cli != cli) return false;
+    s = it->second;
+    s->retired.store(true, memory_order_release);
+    auto drop = [&s](SubList& l) { l.erase(remove(l.begin(), l.end(), s), l.end()); };
+    for (auto& k : m_subByKey) drop(k.second);
+    for (auto& k : m_subByMod) drop(k.second);
+    for (auto& k : m_subByVar) drop(k.second);
+    for (auto& k : m_subByVes) drop(k.second);
+    drop(m_subAll);
+    m_subs.erase(it);
+    m_subCount--;
+  }
+  unsigned int mine = static_cast<unsigned int>(count(m_subHeld.begin(), m_subHeld.end(), s.get()));
+  while (s->calls.load(memory_order_acquire) > mine) this_thread::yield();
+  return true;
+}
+
+// Delivers everything the client's frame mode subscriptions collected since its last Dispatch, one callback per
+// changed key with its type as it stands now. A key gone with a ResetSession is skipped. Returns false if there was
+// nothing to deliver. Clients call it once per frame (e.g. from clbkPreStep), so it is also what ends a frame for the
+// object type memo.
+bool MMExt2_Core::Dispatch(const string& cli) {
+  m_frame.fetch_add(1, memory_order_relaxed);
+  if (m_subCount.load(memory_order_relaxed) == 0) return false;
+  vector<Note> due;
+  {
+    shared_lock<shared_timed_mutex> rd(m_subLock);
+    for (auto& it : m_subs) {
+      const shared_ptr<Sub>& s = it.second;
+      if (!s->frame || s->cli != cli) continue;
+      lock_guard<mutex> lk(s->pendLock);
+      for (unsigned int h : s->pend) SubHold(s, h, &due);
+      s->pend.clear();
+      s->pendSet.clear();
+    }
+  }
+  bool any = false;
+  for (const auto& n : due) {
+    MMKey key;
+    key.h = n.h;
+    Entry* e = _Entry(key);
+    if (!e) {
+      SubDone(n);
+      continue;
+    }
+    char typ;
+    {
+      shared_lock<shared_timed_mutex> rd(_Shard(e->hash).lock);
+      typ = e->typ;
+    }
+    SubCall(n, e->mod->c_str(), e->var, e->ohv, typ);
+    any = true;
+  }
+  return any;
+}
+
+unsigned int MMExt2_Core::Client(const char* cli, CliStats** stats) {
+  if (m_logLocal.cliLast.stats && !strcmp(cli, m_logLocal.cliName.c_str())) {
+    if (stats) *stats = m_logLocal.cliLast.stats;
+    return m_logLocal.cliLast.ix;
   }
+  m_logLocal.cliName = cli;
+  unordered_map<string, CliRef>::const_iterator cached = m_logLocal.clis.find(m_logLocal.cliName);
+  if (cached != m_logLocal.clis.end()) {
+    m_logLocal.cliLast = cached->second;
+    if (stats) *stats = cached->second.stats;
+    return cached->second.ix;
+  }
+  CliRef ref;
+  {
+    shared_lock<shared_timed_mutex> rd(m_cliLock);
+    unordered_map<string, unsigned int>::const_iterator it = m_cliIxs.find(cli);
+    ref.ix = (it != m_cliIxs.end() ? it->second : static_cast<unsigned int>(m_clis.size()));
+    ref.stats = (it != m_cliIxs.end() ? &m_cliStats[ref.ix] : NULL);
+  }
+  if (!ref.stats) {
+    unique_lock<shared_timed_mutex> wr(m_cliLock);
+    unordered_map<string, unsigned int>::const_iterator it = m_cliIxs.find(cli);
+    if (it != m_cliIxs.end()) {
+      ref.ix = it->second;
+    } else {
+      ref.ix = static_cast<unsigned int>(m_clis.size());
+      m_clis.push_back(cli);
+      m_cliStats.emplace_back();
+      m_cliIxs[cli] = ref.ix;
+    }
+    ref.stats = &m_cliStats[ref.ix];
+  }
+  m_logLocal.clis[m_logLocal.cliName] = ref;
+  m_logLocal.cliLast = ref;
+  if (stats) *stats = ref.stats;
+  return ref.ix;
+}
+
+MMExt2_Core::OpStats::OpStats() : calls(0), misses(0), bytes(0) {
+  for (unsigned int b = 0; b < MMSTAT_BUCKETS; b++) hist[b].store(0, memory_order_relaxed);
+}
 
-  s = string() + ves + m_token + mod + m_token + var;
-  string logmsg = cli + m_token + act + m_token + (res?"S":"F") + m_token + s; 
-  auto it = find(m_activitylog.begin(),m_activitylog.end(),logmsg);
-  if (it == m_activitylog.end()) m_activitylog.push_back(logmsg);
+inline unsigned long long _Ns() {
+  return static_cast<unsigned long long>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Start of a counted call: the clock reading if this one is to be timed (every call, while tracing), else 0
+unsigned long long MMExt2_Core::StatBegin() {
+  if (++m_logLocal.statTick % STAT_SAMPLE && !m_trcOn.load(memory_order_relaxed)) return 0;
+  return _Ns();
+}
+
+// End of a counted call, on key handle h if it has one. Passes res back, so a call can finish with return Stat(...).
+bool MMExt2_Core::Stat(const char* cli, const int op, const unsigned long long t0, const bool res, const size_t bytes,
+                       const unsigned int h) {
+  CliStats* cs;
+  unsigned int ix = Client(cli, &cs);
+  OpStats& s = cs->op[op];
+  s.calls.fetch_add(1, memory_order_relaxed);
+  if (!res) s.misses.fetch_add(1, memory_order_relaxed);
+  if (bytes) s.bytes.fetch_add(bytes, memory_order_relaxed);
+  if (t0) {
+    unsigned long long t1 = _Ns();
+    s.hist[MMStats::Bucket(t1 - t0)].fetch_add(1, memory_order_relaxed);
+    if (m_trcOn.load(memory_order_relaxed)) Trace(ix, op, t0, t1, res, h);
+  }
+  if (h && (op == MMSTAT_GET || op == MMSTAT_PUT) && !(m_logLocal.statTick % STAT_SAMPLE)) Hot(h, op == MMSTAT_PUT);
   return res;
 }
 
-bool MMExt2_Core::GetLog(char *rFunc, string *rCli, string *rMod, string* rVar, string* rVes, bool *rSuccess, int* ix, const string& cli, bool skp) {
-  if (*ix == 0) Log(cli, "L", true, "");
-  int rIx;
-  bool repeat;
-  do {
-    repeat = false;
-    rIx = m_activitylog.size() - *ix - 1;
-    if (rIx < 0) return false;
-    string func, success;
-    istringstream is(m_activitylog[rIx]);
-    getline(is, *rCli, m_token);
-    getline(is, func, m_token);
-    getline(is, success, m_token);
-    getline(is, *rVes, m_token);
-    getline(is, *rMod, m_token);
-    getline(is, *rVar, m_token);
-    *rFunc = func[0];
-    *rSuccess = (success == "S");
-    if (skp && (*rCli == cli)) {
-      (*ix)++;
-      repeat = true;
+MMExt2_Core::HotTable::HotTable() : from(-1.0) {
+  lock_guard<mutex> lk(m_hotLock);
+  m_hotTables.push_back(this);
+}
+
+MMExt2_Core::HotTable::~HotTable() {
+  lock_guard<mutex> lk(m_hotLock);
+  for (const HotSlot& s : slots) {
+    HotSlot& l = m_hotLeft.insert(make_pair(s.h, HotSlot{ s.h, 0, 0, 0, 0 })).first->second;
+    l.n += s.n;
+    l.err += s.err;
+    l.gets += s.gets;
+    l.puts += s.puts;
+  }
+  if (!slots.empty() && (m_hotLeftFrom < 0 || from < m_hotLeftFrom)) m_hotLeftFrom = from;
+  m_hotTables.erase(find(m_hotTables.begin(), m_hotTables.end(), this));
+}
+
+// Only this thread's table is touched, so the lock is uncontended but for HotKeys and ResetSession
+void MMExt2_Core::Hot(const unsigned int h, const bool put) {
+  HotTable& t = m_hotLocal;
+  lock_guard<mutex> lk(t.lock);
+  if (t.slots.empty()) t.from = oapiGetSimTime();
+  HotSlot* s;
+  unordered_map<unsigned int, size_t>::iterator it = t.ixs.find(h);
+  if (it != t.ixs.end()) {
+    s = &t.slots[it->second];
+  } else if (t.slots.size() < HOT_SLOTS) {
+    HotSlot add = { h, 0, 0, 0, 0 };
+    t.ixs[h] = t.slots.size();
+    t.slots.push_back(add);
+    s = &t.slots.back();
+  } else {
+    size_t ix = 0;
+    for (size_t i = 1; i < t.slots.size(); i++) {
+      if (t.slots[i].n < t.slots[ix].n) ix = i;
     }
-  } while (repeat);
-  (*ix)++;
+    s = &t.slots[ix];
+    t.ixs.erase(s->h);
+    t.ixs[h] = ix;
+    s->h = h;
+    s->err = s->n;
+    s->gets = s->puts = 0;
+  }
+  s->n++;
+  if (put) {
+    s->puts++;
+  } else {
+    s->gets++;
+  }
+}
+
+// The threads' summaries add up key by key. A key missing from a full summary may still have had up to that
+// summary's smallest count there, so that much goes on its n and err (as space-saving does for a new key).
+bool MMExt2_Core::HotKeys(MMHotKey* rKeys, size_t* nKeys, char* rNames, size_t* lNames) {
+  vector<vector<HotSlot>> tables;
+  unordered_map<unsigned int, HotSlot> sum;
+  double from;
+  {
+    lock_guard<mutex> lk(m_hotLock);
+    sum = m_hotLeft;
+    from = m_hotLeftFrom;
+    for (HotTable* t : m_hotTables) {
+      lock_guard<mutex> lt(t->lock);
+      if (t->slots.empty()) continue;
+      tables.push_back(t->slots);
+      if (from < 0 || t->from < from) from = t->from;
+    }
+  }
+  for (const vector<HotSlot>& t : tables) {
+    for (const HotSlot& s : t) {
+      HotSlot& a = sum.insert(make_pair(s.h, HotSlot{ s.h, 0, 0, 0, 0 })).first->second;
+      a.n += s.n;
+      a.err += s.err;
+      a.gets += s.gets;
+      a.puts += s.puts;
+    }
+  }
+  for (const vector<HotSlot>& t : tables) {
+    if (t.size() < HOT_SLOTS) continue;
+    unsigned long long floor = t[0].n;
+    unordered_set<unsigned int> in;
+    for (const HotSlot& s : t) {
+      floor = min(floor, s.n);
+      in.insert(s.h);
+    }
+    for (pair<const unsigned int, HotSlot>& a : sum) {
+      if (in.count(a.first)) continue;
+      a.second.n += floor;
+      a.second.err += floor;
+    }
+  }
+  vector<HotSlot> top;
+  top.reserve(sum.size());
+  for (const pair<const unsigned int, HotSlot>& a : sum) top.push_back(a.second);
+  double span = (from < 0 ? 0.0 : oapiGetSimTime() - from);
+  double per = STAT_SAMPLE / max(span, 1.0);  // over at least a sim second, so a short run does not read as a storm
+  sort(top.begin(), top.end(), [](const HotSlot& a, const HotSlot& b) { return a.n > b.n; });
+  size_t mxKeys = *nKeys, mxNames = *lNames, n = 0, used = 0;
+  bool fits = true;
+  for (size_t i = 0, k = 0; i < top.size() && k < mxKeys; i++) {
+    MMKey key;
+    key.h = top[i].h;
+    const Entry* e = _Entry(key);
+    if (!e) continue;
+    k++;
+    size_t lMod = e->mod->length() + 1, lVar = strlen(e->var) + 1;
+    if (fits && used + lMod + lVar > mxNames) fits = false;  // from here on keys are only sized, so the list has no gaps
+    if (fits) {
+      MMHotKey& r = rKeys[n++];
+      r.ohv = e->ohv;
+      r.key = key;
+      r.mod = static_cast<unsigned int>(used);
+      r.var = static_cast<unsigned int>(used + lMod);
+      r.gets = top[i].gets * per;
+      r.puts = top[i].puts * per;
+      r.err = top[i].err * per;
+      memcpy(rNames + r.mod, e->mod->c_str(), lMod);
+      memcpy(rNames + r.var, e->var, lVar);
+    }
+    used += lMod + lVar;
+  }
+  *nKeys = n;
+  *lNames = used;
   return true;
 }
 
-bool MMExt2_Core::ResetLog() {
-  m_activitylog.clear();
+// Appends the top keys to the HotKeyDump file, as text, for the session ending
+void MMExt2_Core::HotDump() {
+  if (m_hotDump.empty()) return;
+  MMHotKey keys[HOT_DUMP];
+  char names[HOT_DUMP * 128];
+  size_t nKeys = HOT_DUMP, lNames = sizeof(names);
+  if (!HotKeys(keys, &nKeys, names, &lNames) || !nKeys) return;
+  FILE* f = fopen(m_hotDump.c_str(), "a");
+  if (!f) return;
+  fprintf(f, "Hot keys at sim time %.1f (calls per sim second, +err)\n", oapiGetSimTime());
+  for (size_t i = 0; i < nKeys; i++) {  // only the keys whose names fit are filled in
+    char ves[256] = "*";
+    if (keys[i].ohv) oapiGetObjectName(keys[i].ohv, ves, sizeof(ves));
+    fprintf(f, "%3u %10.1f get %10.1f put %10.1f err  %s:%s:%s\n", static_cast<unsigned int>(i + 1), keys[i].gets,
+            keys[i].puts, keys[i].err, ves, names + keys[i].mod, names + keys[i].var);
+  }
+  fclose(f);
+}
+
+bool MMExt2_Core::Refused(const char* cli, const int op) {
+  return Stat(cli, op, 0, false, 0);
+}
+
+bool MMExt2_Core::GetStats(const unsigned int ix, const char** cli, const int op, MMStats* stats) {
+  if (op < 0 || op >= MMSTAT_OPS) return false;
+  const OpStats* s;
+  {
+    shared_lock<shared_timed_mutex> rd(m_cliLock);
+    if (ix >= m_clis.size()) return false;
+    *cli = m_clis[ix].c_str();
+    s = &m_cliStats[ix].op[op];
+  }
+  stats->calls = s->calls.load(memory_order_relaxed);
+  stats->misses = s->misses.load(memory_order_relaxed);
+  stats->bytes = s->bytes.load(memory_order_relaxed);
+  stats->timed = 0;  // the sum of the buckets, so it always agrees with hist
+  for (unsigned int b = 0; b < MMSTAT_BUCKETS; b++) {
+    stats->hist[b] = s->hist[b].load(memory_order_relaxed);
+    stats->timed += stats->hist[b];
+  }
   return true;
 }
 
-bool MMExt2_Core::GetVer(const char* mod, char* val, size_t *len) {
-  string s = string() + "MMExt " + MMEXT2_VERSION_NUMBER + " - " + __DATE__;
-  if (*len > s.length()) {
-    strcpy(val, s.c_str());
-  };
-  *len = s.length() + 1;
-  return Log(mod, "V", true, "");
+MMExt2_Core::TraceBuf::TraceBuf() : ring(new TraceEv[TRACE_RING]), head(0), tail(0), frameAt(-1.0), frame(0) {
+  lock_guard<mutex> lk(m_trcLock);
+  tid = ++m_trcTids;
+  m_trcBufs.push_back(this);
 }
 
-bool MMExt2_Core::Find(char* rTyp, string* rMod, string* rVar, OBJHANDLE* rOhv, int* ix, const string& cli, const string& mod, const string& var, const OBJHANDLE ohv, bool skp) {
-  int foundIx;
-  string itsOhv, itMod, itVar, id;
-  OBJHANDLE itOhv;
-  bool doAgain;
-  do {
-    foundIx = 0;
-    doAgain = false;
-    for (const auto& it : m_types) {
-      istringstream is(it.first);
-      getline(is, itsOhv, m_token);
-      int ret = sscanf(itsOhv.c_str(), "%p", &itOhv);
-      if (ret != 1) return false;
-      getline(is, itMod, m_token);
-      getline(is, itVar, m_token);
-      id = _Id((itMod).c_str(), (itVar).c_str(), itOhv);
-      if (!ValidateObjHandle(cli, id, itOhv)) {
-        doAgain = true; // invalidated pointers now on the m_types, so retry from beginning
-        break;
-      }
+MMExt2_Core::TraceBuf::~TraceBuf() {
+  lock_guard<mutex> lk(m_trcLock);
+  unsigned int h = head.load(memory_order_acquire);
+  if (m_trcFile) {
+    for (unsigned int t = tail.load(memory_order_relaxed); t != h; t++) TraceOut(*this, ring[t % TRACE_RING]);
+  }
+  m_trcBufs.erase(find(m_trcBufs.begin(), m_trcBufs.end(), this));
+}
 
-      if (((mod == "*") || (mod == itMod)) && ((var == "*") || (var == itVar)) && ((ohv == NULL) || (ohv == itOhv)) && ((!skp) || (cli != itMod))) {
-        if (foundIx >= *ix) {
-          *rTyp = it.second;
-          *rMod = itMod;
-          *rVar = itVar;
-          *rOhv = itOhv;
-          if (*rTyp == 'o') {
-            OBJHANDLE obj_handle;
-            SearchMap<OBJHANDLE>(cli, id, m_OBJHANDLEs, &obj_handle); // we know it will be true
-            if (!ValidateObjHandle(cli, id, obj_handle)) {
-              doAgain = true; // invalidated pointers now on the m_types
-              break;
-            }
-          }
-          if (*ix == 0) Log(cli, "F", true, _Id(mod.c_str(), var.c_str(), ohv, true));
-          return true;
-        }
-      }
-      foundIx++;
+// Frame number: counts Orbiter's system time steps, as it is fixed for the whole of a frame. Each thread checks the
+// shared count once per frame.
+unsigned int MMExt2_Core::TraceFrame() {
+  TraceBuf& b = m_trcLocal;
+  double now = oapiGetSysTime();
+  if (now != b.frameAt) {
+    lock_guard<mutex> lk(m_trcFrameLock);
+    if (now > m_trcFrameAt) {
+      m_trcFrameAt = now;
+      m_trcFrame++;
     }
-  } while (doAgain);
-  return false;
+    b.frameAt = now;
+    b.frame = m_trcFrame;
+  }
+  return b.frame;
 }
 
-// 
-// STATIC ENTRY POINTS FOR MMExt2_Internal
-// If you change this interface, make a new V2, V3 set of entry points and fix up the compatibility for all apps using these original ones. 
-//
+void MMExt2_Core::Trace(const unsigned int cli, const int op, const unsigned long long t0, const unsigned long long t1,
+                        const bool res, const unsigned int h) {
+  TraceBuf& b = m_trcLocal;
+  unsigned int head = b.head.load(memory_order_relaxed);
+  unsigned int used = head - b.tail.load(memory_order_acquire);
+  if (used >= TRACE_RING) {
+    m_trcDropped.fetch_add(1, memory_order_relaxed);
+    return;
+  }
+  TraceEv& ev = b.ring[head % TRACE_RING];
+  ev.t0 = t0;
+  ev.t1 = t1;
+  ev.cli = cli;
+  ev.h = h;
+  ev.frame = TraceFrame();
+  ev.op = static_cast<unsigned char>(op);
+  ev.res = res;
+  b.head.store(head + 1, memory_order_release);
+  if (used == TRACE_RING / 2) m_trcWake.notify_one();
+}
+
+inline void _JsonStr(FILE* f, const char* s) {
+  fputc('"', f);
+  for (; *s; s++) {
+    unsigned char c = static_cast<unsigned char>(*s);
+    if (c == '"' || c == '\\') {
+      fputc('\\', f);
+      fputc(c, f);
+    } else if (c < 0x20) {
+      fprintf(f, "\\u%04x", c);
+    } else {
+      fputc(c, f);
+    }
+  }
+  fputc('"', f);
+}
+
+// One complete ("X") event, with the begin time and duration in us. Called under m_trcLock.
+void MMExt2_Core::TraceOut(const TraceBuf& b, const TraceEv& ev) {
+  static const char* ops[MMSTAT_OPS] = { "Put", "Get", "Delete", "Find", "GetLog" };
+  const char* cli;
+  {
+    shared_lock<shared_timed_mutex> rd(m_cliLock);
+    cli = m_clis[ev.cli].c_str();
+  }
+  fprintf(m_trcFile, "%s\n{\"name\":\"%s\",\"cat\":\"mmext2\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%llu.%03u,\"dur\":%llu.%03u,"
+          "\"args\":{\"cli\":", m_trcFirst ? "" : ",", ops[ev.op], b.tid, ev.t0 / 1000, static_cast<unsigned int>(ev.t0 % 1000),
+          (ev.t1 - ev.t0) / 1000, static_cast<unsigned int>((ev.t1 - ev.t0) % 1000));
+  _JsonStr(m_trcFile, cli);
+  MMKey key;
+  key.h = ev.h;
+  const Entry* e = (ev.h ? _Entry(key) : NULL);
+  if (e) {
+    fputs(",\"mod\":", m_trcFile);
+    _JsonStr(m_trcFile, e->mod->c_str());
+    fputs(",\"var\":", m_trcFile);
+    _JsonStr(m_trcFile, e->var);
+  }
+  fprintf(m_trcFile, ",\"frame\":%u,\"ok\":%s}}", ev.frame, ev.res ? "true" : "false");
+  m_trcFirst = false;
+}
+
+void MMExt2_Core::TraceDrain() {
+  lock_guard<mutex> lk(m_trcLock);
+  if (!m_trcFile) return;
+  for (TraceBuf* b : m_trcBufs) {
+    unsigned int h = b->head.load(memory_order_acquire);
+    for (unsigned int t = b->tail.load(memory_order_relaxed); t != h; t++) TraceOut(*b, b->ring[t % TRACE_RING]);
+    b->tail.store(h, memory_order_release);
+  }
+}
+
+void MMExt2_Core::TraceThread() {
+  unique_lock<mutex> lk(m_trcLock);
+  while (!m_trcStop) {
+    m_trcWake.wait_for(lk, chrono::milliseconds(TRACE_PERIOD));
+    lk.unlock();
+    TraceDrain();
+    lk.lock();
+  }
+}
+
+bool MMExt2_Core::TraceStart(const char* path) {
+  lock_guard<mutex> ctl(m_trcCtl);
+  {
+    lock_guard<mutex> lk(m_trcLock);
+    if (m_trcFile) return false;
+    if (!(m_trcFile = fopen(path, "w"))) return false;
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", m_trcFile);
+    m_trcFirst = true;
+    for (TraceBuf* b : m_trcBufs) {    // drop anything left over from stragglers of the last trace
+      b->tail.store(b->head.load(memory_order_acquire), memory_order_release);
+    }
+    m_trcStop = false;
+  }
+  m_trcDropped.store(0);
+  m_trcThread = thread(TraceThread);
+  m_trcOn.store(true);
+  return true;
+}
+
+bool MMExt2_Core::TraceStop() {
+  lock_guard<mutex> ctl(m_trcCtl);
+  if (!m_trcOn.exchange(false)) return false;
+  {
+    lock_guard<mutex> lk(m_trcLock);
+    m_trcStop = true;
+  }
+  m_trcWake.notify_all();
+  if (m_trcThread.joinable()) m_trcThread.join();
+  TraceDrain();
+  lock_guard<mutex> lk(m_trcLock);
+  fprintf(m_trcFile, "\n],\"otherData\":{\"dropped\":\"%llu\"}}\n", m_trcDropped.load());
+  bool ok = (fclose(m_trcFile) == 0);
+  m_trcFile = NULL;
+  return ok;
+}
+
+bool MMExt2_Core::Record(const char* cli, const char act, const bool& res, const unsigned int h, const bool query) {
+  int mode = m_logMode.load(memory_order_relaxed);
+  if (mode == MMLOG_SAMPLED && (m_logTick.fetch_add(1, memory_order_relaxed) + 1) % m_logSample.load(memory_order_relaxed) != 0) return res;
+  unsigned int c = Client(cli);
+  bool dedup = (mode == MMLOG_FIRST);
+  unsigned long long sig = _LogSig(c, h, act, res, query);
+  if (dedup) {
+    unsigned int epoch = m_logEpoch.load(memory_order_acquire);
+    if (m_logLocal.epoch != epoch) {
+      m_logLocal.sigs.clear();
+      m_logLocal.epoch = epoch;
+    }
+    if (!m_logLocal.sigs.insert(sig).second) return res;  // this thread has logged it already: no shared state touched
+  }
+  lock_guard<mutex> lk(m_logLock);
+  if (dedup && !m_logSeen.insert(sig).second) return res;
+  if (m_log.empty()) m_log.resize(LOG_CAPACITY);
+  LogRec& r = m_log[m_logHead];
+  if (m_logCount == LOG_CAPACITY) {
+    if (r.dedup) {
+      m_logSeen.erase(_LogSig(r.cli, r.h, r.act, r.res, r.query)); // overwriting the oldest record, so let it be logged again
+      m_logEpoch.fetch_add(1, memory_order_release);
+    }
+  } else {
+    m_logCount++;
+  }
+  r.simt = oapiGetSimTime();
+  r.cli = c;
+  r.h = h;
+  r.act = act;
+  r.res = res;
+  r.dedup = dedup;
+  r.query = query;
+  m_logHead = (m_logHead + 1) % LOG_CAPACITY;
+  return res;
+}
+
+bool MMExt2_Core::GetLog(char *rFunc, string *rCli, string *rMod, string* rVar, string* rVes, bool *rSuccess, int* ix, const string& cli, bool skp) {
+  const char *c, *m, *v, *s;
+  if (!GetLog(rFunc, &c, &m, &v, &s, rSuccess, ix, cli, skp)) return false;
+  *rCli = c;
+  *rMod = m;
+  *rVar = v;
+  *rVes = s;
+  return true;
+}
+
+bool MMExt2_Core::GetLog(char *rFunc, const char** rCli, const char** rMod, const char** rVar, const char** rVes, bool *rSuccess, int* ix, const string& cli, bool skp) {
+  unsigned long long t0 = StatBegin();
+  if (*ix == 0) Log(cli.c_str(), 'L', true, NULL, "*", "*");
+  unsigned int c = Client(cli.c_str());
+  LogRec r;
+  {
+    lock_guard<mutex> lk(m_logLock);
+    do {
+      if (*ix < 0 || static_cast<size_t>(*ix) >= m_logCount) return Stat(cli.c_str(), MMSTAT_LOG, t0, false, 0);
+      r = m_log[(m_logHead + LOG_CAPACITY - 1 - *ix) % LOG_CAPACITY]; // newest first
+      (*ix)++;
+    } while (skp && r.cli == c);
+  }
+
+  OBJHANDLE ohv;
+  if (r.query) {
+    shared_lock<shared_timed_mutex> rd(m_qryLock);
+    const Query& q = m_qrys[r.h - 1];
+    ohv = q.ohv;
+    *rMod = q.mod.c_str();
+    *rVar = q.var.c_str();
+  } else {
+    MMKey key;
+    key.h = r.h;
+    const Entry* e = _Entry(key);
+    ohv = e->ohv;
+    *rMod = e->mod->c_str();
+    *rVar = e->var;
+  }
+  *rFunc = r.act;
+  *rSuccess = r.res;
+  {
+    shared_lock<shared_timed_mutex> rd(m_cliLock);
+    *rCli = m_clis[r.cli].c_str();
+  }
+  if (!ohv) {
+    *rVes = "*";
+  } else if (_IsVessel(ohv)) {
+    *rVes = oapiGetVesselInterface(ohv)->GetName();
+  } else {
+    *rVes = "?";  // vessel deleted since the record was written
+  }
+  return Stat(cli.c_str(), MMSTAT_LOG, t0, true, 0);
+}
+
+bool MMExt2_Core::ResetLog() {
+  lock_guard<mutex> lk(m_logLock);
+  m_logEpoch.fetch_add(1, memory_order_release);
+  m_logHead = 0;
+  m_logCount = 0;
+  m_logSeen.clear();
+  return true;
+}
+
+// Numeric Gets read under the sequence counter by default. Off sends them through the shard lock like every other type.
+void MMExt2_Core::SetSeqRead(const bool on) {
+  m_seqRead.store(on, memory_order_relaxed);
+}
 
-DLLCLBK bool ModMsgGet_ver_v1(                       const char* mod,                  char* val, size_t *len)                    { return gCore.GetVer(mod, val, len); };
-DLLCLBK bool ModMsgPut_int_v1(                       const char* mod, const char* var, const int& val,       const OBJHANDLE ohv) { return gCore.Put(string(mod), _Id(mod, var, ohv), val); }
-DLLCLBK bool ModMsgPut_bool_v1(                      const char* mod, const char* var, const bool& val,      const OBJHANDLE ohv) { return gCore.Put(string(mod), _Id(mod, var, ohv), val); }
-DLLCLBK bool ModMsgPut_double_v1(                    const char* mod, const char* var, const double& val,    const OBJHANDLE ohv) { return gCore.Put(string(mod), _Id(mod, var, ohv), val); }
-DLLCLBK bool ModMsgPut_VECTOR3_v1(                   const char* mod, const char* var, const VECTOR3& val,   const OBJHANDLE ohv) { return gCore.Put(string(mod), _Id(mod, var, ohv), val); }
-DLLCLBK bool ModMsgPut_MATRIX3_v1(                   const char* mod, const char* var, const MATRIX3& val,   const OBJHANDLE ohv) { return gCore.Put(string(mod), _Id(mod, var, ohv), val); }
-DLLCLBK bool ModMsgPut_MATRIX4_v1(                   const char* mod, const char* var, const MATRIX4& val,   const OBJHANDLE ohv) { return gCore.Put(string(mod), _Id(mod, var, ohv), val); }
-DLLCLBK bool ModMsgPut_OBJHANDLE_v1(                 const char* mod, const char* var, const OBJHANDLE& val, const OBJHANDLE ohv) { return gCore.Put(string(mod), _Id(mod, var, ohv), val); }
-DLLCLBK bool ModMsgPut_MMStruct_v1(                  const char* mod, const char* var, const MMStruct* val,  const OBJHANDLE ohv) { return gCore.Put(string(mod), _Id(mod, var, ohv), val); }
-DLLCLBK bool ModMsgPut_MMBase_v1(                    const char* mod, const char* var, const EnjoLib::ModuleMessagingExtBase* val, const OBJHANDLE ohv)
-                                                                                                                                  { return gCore.Put(string(mod), _Id(mod, var, ohv), val); }
-DLLCLBK bool ModMsgDel_any_v1(                       const char* mod, const char* var, const OBJHANDLE ohv)                       { return gCore.Delete(mod, _Id(mod, var, ohv)); }
-DLLCLBK bool ModMsgGet_int_v1(      const char* cli, const char* mod, const char* var, int* val,             const OBJHANDLE ohv) { return gCore.Get(string(cli), _Id(mod, var, ohv), val); }
-DLLCLBK bool ModMsgGet_bool_v1(     const char* cli, const char* mod, const char* var, bool* val,            const OBJHANDLE ohv) { return gCore.Get(string(cli), _Id(mod, var, ohv), val); }
-DLLCLBK bool ModMsgGet_double_v1(   const char* cli, const char* mod, const char* var, double* val,          const OBJHANDLE ohv) { return gCore.Get(string(cli), _Id(mod, var, ohv), val); }
-DLLCLBK bool ModMsgGet_VECTOR3_v1(  const char* cli, const char* mod, const char* var, VECTOR3* val,         const OBJHANDLE ohv) { return gCore.Get(string(cli), _Id(mod, var, ohv), val); }
-DLLCLBK bool ModMsgGet_MATRIX3_v1(  const char* cli, const char* mod, const char* var, MATRIX3* val,         const OBJHANDLE ohv) { return gCore.Get(string(cli), _Id(mod, var, ohv), val); }
-DLLCLBK bool ModMsgGet_MATRIX4_v1(  const char* cli, const char* mod, const char* var, MATRIX4* val,         const OBJHANDLE ohv) { return gCore.Get(string(cli), _Id(mod, var, ohv), val); }
-DLLCLBK bool ModMsgGet_OBJHANDLE_v1(const char* cli, const char* mod, const char* var, OBJHANDLE* val,       const OBJHANDLE ohv) { return gCore.Get(string(cli), _Id(mod, var, ohv), val); }
-DLLCLBK bool ModMsgGet_MMStruct_v1( const char* cli, const char* mod, const char* var, const MMStruct** val, const OBJHANDLE ohv) { return gCore.Get(string(cli), _Id(mod, var, ohv), val); }
-DLLCLBK bool ModMsgGet_MMBase_v1(   const char* cli, const char* mod, const char* var, const EnjoLib::ModuleMessagingExtBase** val, const OBJHANDLE ohv)
-                                                                                                                                  { return gCore.Get(string(cli), _Id(mod, var, ohv), val); }
-DLLCLBK int ModMsgObj_typ_v1(const OBJHANDLE& val)                                                                                { return _ObjType(val); }
-
-
-// Special handling for all string functions (do not want to expose the string implementation across compiler versions due to lack of ABI; therefore use char* as the interface)
-
-DLLCLBK bool ModMsgPut_c_str_v1(const char* mod, const char* var, const char* val, const OBJHANDLE ohv) {
-  string str = val;
-  return gCore.Put(string(mod), _Id(mod, var, ohv), str);
-}
-
-DLLCLBK bool ModMsgGet_c_str_v1(const char* cli, const char* mod, const char* var, char *val, size_t *lVal, const OBJHANDLE ohv) {
-  string rVal;
-  if (!gCore.Get(string(cli), _Id(mod, var, ohv), &rVal)) return false;
-  _RemoteCopy(val, lVal, rVal);
+bool MMExt2_Core::SetLogMode(const int mode, const unsigned int sample) {
+  if (mode < MMLOG_OFF || mode > MMLOG_FULL) return false;
+  m_logSample = (sample > 0 ? sample : LOG_SAMPLE);
+  m_logMode = mode;
   return true;
 }
 
+// Optional config file, e.g.
+//   LogMode = off        (off | first | sampled | full)
+//   LogSample = 100      (1 in N calls are logged in sampled mode)
+//   SeqRead = on         (on | off: lock free reads of the numeric types)
+void MMExt2_Core::LoadConfig() {
+  FILE* f = fopen(CONFIG_FILE, "r");
+  if (!f) return;
+  char line[256], item[64], val[64];
+  while (fgets(line, sizeof(line), f)) {
+    if (sscanf(line, " %63[^= \t] = %63s", item, val) != 2) continue;
+    if (!strcmp(item, "LogMode")) {
+      if (!strcmp(val, "off"))     m_logMode = MMLOG_OFF;
+      if (!strcmp(val, "first"))   m_logMode = MMLOG_FIRST;
+      if (!strcmp(val, "sampled")) m_logMode = MMLOG_SAMPLED;
+      if (!strcmp(val, "full"))    m_logMode = MMLOG_FULL;
+    } else if (!strcmp(item, "LogSample")) {
+      int n = atoi(val);
+      if (n > 0) m_logSample = n;
+    } else if (!strcmp(item, "SeqRead")) {
+      SetSeqRead(strcmp(val, "off") != 0);
+    } else if (!strcmp(item, "HotKeyDump")) {
+      m_hotDump = val;
+    }
+  }
+  fclose(f);
+}
 
-DLLCLBK bool ModMsgFind_v1(char *rTyp, char *rMod, size_t *lMod, char *rVar, size_t *lVar, OBJHANDLE* rOhv, int* ix,
-                           const char* cli, const char* mod, const char* var, const OBJHANDLE ohv, const bool skpSelf) {
-  string iCli = cli, iMod = mod, iVar = var, irMod, irVar;
-  if (!gCore.Find(rTyp, &irMod, &irVar, rOhv, ix, iCli, iMod, iVar, ohv, skpSelf)) return false;
-  _RemoteCopy(rMod, lMod, irMod);
-  _RemoteCopy(rVar, lVar, irVar);
+bool MMExt2_Core::GetVer(const char* mod, char* val, size_t *len) {
+  const char* s;
+  GetVer(mod, &s);
+  size_t n = strlen(s) + 1;
+  if (n <= *len) memcpy(val, s, n);
+  *len = n;
   return true;
 }
 
-DLLCLBK bool ModMsgGet_log_v1(char* rFunc, 
-                              char* rCli, size_t* lCli,
-                              char* rMod, size_t* lMod,
-                              char* rVar, size_t* lVar,
-                              char* rVes, size_t* lVes,
-                              bool* rSucc, int *ix,
-                              const char* get, const bool skp ) {
-  string iCli, iMod, iVar, iVes;
-  if (!gCore.GetLog(rFunc, &iCli, &iMod, &iVar, &iVes, rSucc, ix, get, skp)) return false;
-
-  _RemoteCopy(rCli, lCli, iCli);
-  _RemoteCopy(rMod, lMod, iMod);
-  _RemoteCopy(rVar, lVar, iVar);
-  _RemoteCopy(rVes, lVes, iVes);
+bool MMExt2_Core::GetVer(const char* mod, const char** val) {
+  static const string s = string() + "MMExt " + MMEXT2_VERSION_NUMBER + " - " + __DATE__;
+  *val = s.c_str();
+  return Log(mod, 'V', true, NULL, "*", "*");
+}
+
+// Steps the cursor to the next match. Runs over the most specific index the query has (vessel, then module, then
+// variable), so the cost is proportional to that index rather than to the whole store. A key whose vessel (or stored
+// handle) has gone is expunged once the index lock is dropped, so the delete and its notifications run unlocked.
+bool MMExt2_Core::FindNext(MMCursor* cur, char* rTyp, const string& cli, const string& mod, const string& var, const OBJHANDLE ohv, bool skp) {
+  for (;;) {
+    MMKey dead;
+    {
+      shared_lock<shared_timed_mutex> ix(m_index);
+      const HandleList* list = NULL;
+      if (ohv) {
+        unordered_map<OBJHANDLE, HandleList>::const_iterator it = m_byVes.find(ohv);
+        if (it == m_byVes.end()) return false;
+        list = &it->second;
+      } else if (mod != "*") {
+        unordered_map<string, HandleList>::const_iterator it = m_byMod.find(mod);
+        if (it == m_byMod.end()) return false;
+        list = &it->second;
+      } else if (var != "*") {
+        unordered_map<string, HandleList>::const_iterator it = m_byVar.find(var);
+        if (it == m_byVar.end()) return false;
+        list = &it->second;
+      }
+      size_t n = (list ? list->size() : m_count.load(memory_order_acquire));
+      if (list && cur->last) {
+        // keys may have left the list since the last step, so pick up after the last match by handle, not position
+        cur->pos = static_cast<unsigned int>(upper_bound(list->begin(), list->end(), cur->last) - list->begin());
+      }
+      MMKey key;
+      while (cur->pos < n) {
+        key.h = (list ? (*list)[cur->pos] : _Handle(cur->pos));
+        cur->pos++;
+        Entry* e = _Entry(key);
+        if (!e || !e->indexed.load(memory_order_acquire)) continue;  // reset under us, or not yet (or no longer) indexed
+        if (!(((mod == "*") || (mod == *e->mod)) && ((var == "*") || (var == e->var)) && ((ohv == NULL) || (ohv == e->ohv)) && ((!skp) || (cli != *e->mod)))) continue;
+        char typ;
+        OBJHANDLE obj;
+        {
+          shared_lock<shared_timed_mutex> rd(_Shard(e->hash).lock);
+          typ = e->typ;
+          obj = e->val.o;
+        }
+        if (typ == '\0') continue;
+        if (!m_vesEvents.load(memory_order_relaxed) && (HandleType(e->ohv) == OBJTP_INVALID || (typ == 'o' && HandleType(obj) == OBJTP_INVALID))) {
+          dead = key;
+          break;
+        }
+        cur->last = key.h;
+        *rTyp = typ;
+        return true;
+      }
+    }
+    if (!dead.IsValid()) return false;
+    Delete("{core}", dead);
+  }
+}
+
+bool MMExt2_Core::Find(char* rTyp, string* rMod, string* rVar, OBJHANDLE* rOhv, MMCursor* cur, const string& cli, const string& mod, const string& var, const OBJHANDLE ohv, bool skp) {
+  const char *m, *v;
+  if (!Find(rTyp, &m, &v, rOhv, cur, cli, mod, var, ohv, skp)) return false;
+  *rMod = m;
+  *rVar = v;
   return true;
 }
 
-DLLCLBK bool ModMsgRst_log_v1() { return gCore.ResetLog(); }
+bool MMExt2_Core::Find(char* rTyp, const char** rMod, const char** rVar, OBJHANDLE* rOhv, MMCursor* cur, const string& cli, const string& mod, const string& var, const OBJHANDLE ohv, bool skp) {
+  unsigned long long t0 = StatBegin();
+  if (cur->pos == 0) Log(cli.c_str(), 'F', true, ohv, mod.c_str(), var.c_str());
+  if (!FindNext(cur, rTyp, cli, mod, var, ohv, skp)) return Stat(cli.c_str(), MMSTAT_FIND, t0, false, 0);
+  const Entry* e = _Entry(cur->Key());
+  *rMod = e->mod->c_str();
+  *rVar = e->var;
+  *rOhv = e->ohv;
+  return Stat(cli.c_str(), MMSTAT_FIND, t0, true, 0, cur->Key().h);
+}
+
+bool MMExt2_Core::Find(char* rTyp, string* rMod, string* rVar, OBJHANDLE* rOhv, int* ix, const string& cli, const string& mod, const string& var, const OBJHANDLE ohv, bool skp) {
+  if (*ix < 0) return false;
+  FindMemo& m = m_findMemo;
+  unsigned int session = m_session.load(memory_order_relaxed);
+  bool same = (m.session == session && m.ohv == ohv && m.skp == skp && m.cli == cli && m.mod == mod && m.var == var);
+  MMCursor cur;
+  int n = 0;
+  if (same && *ix == m.ix) {
+    cur = m.before;          // repeat of the last call (e.g. a retry with bigger name buffers)
+    n = *ix;
+  } else if (same && *ix == m.ix + 1) {
+    cur = m.after;           // next step of an ix loop
+    n = *ix;
+  }
+  unsigned long long t0 = StatBegin();
+  Log(cli.c_str(), 'F', true, ohv, mod.c_str(), var.c_str());
+  MMCursor before;
+  do {
+    before = cur;
+    if (!FindNext(&cur, rTyp, cli, mod, var, ohv, skp)) return Stat(cli.c_str(), MMSTAT_FIND, t0, false, 0);
+  } while (n++ < *ix);
+  const Entry* e = _Entry(cur.Key());
+  *rMod = e->mod->c_str();
+  *rVar = e->var;
+  *rOhv = e->ohv;
+  m.cli = cli;
+  m.mod = mod;
+  m.var = var;
+  m.ohv = ohv;
+  m.skp = skp;
+  m.ix = *ix;
+  m.session = session;
+  m.before = before;
+  m.after = cur;
+  return Stat(cli.c_str(), MMSTAT_FIND, t0, true, 0, cur.Key().h);
+}
 
+// Writes every match in one pass. Records and names are written while they fit; nRec and lNames always come back
+// with the full count and size, so the caller can tell when to grow its buffers and call again.
+bool MMExt2_Core::FindAll(MMFindRec* rRec, size_t* nRec, char* rNames, size_t* lNames, const string& cli, const string& mod, const string& var, const OBJHANDLE ohv, bool skp) {
+  unsigned long long t0 = StatBegin();
+  size_t mxRec = *nRec, mxNames = *lNames, n = 0, used = 0;
+  Log(cli.c_str(), 'F', true, ohv, mod.c_str(), var.c_str());
+  MMCursor cur;
+  char typ;
+  while (FindNext(&cur, &typ, cli, mod, var, ohv, skp)) {
+    const Entry* e = _Entry(cur.Key());
+    size_t lMod = e->mod->length() + 1, lVar = strlen(e->var) + 1;
+    if (n < mxRec && used + lMod + lVar <= mxNames) {
+      MMFindRec& r = rRec[n];
+      r.typ = typ;
+      r.ohv = e->ohv;
+      r.key = cur.Key();
+      r.mod = used;
+      r.var = used + lMod;
+      memcpy(rNames + r.mod, e->mod->c_str(), lMod);
+      memcpy(rNames + r.var, e->var, lVar);
+    }
+    n++;
+    used += lMod + lVar;
+  }
+  *nRec = n;
+  *lNames = used;
+  return Stat(cli.c_str(), MMSTAT_FIND, t0, true, (used <= mxNames ? used : 0));
+}
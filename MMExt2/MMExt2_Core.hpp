@@ -25,15 +25,30 @@
 // ==============================================================
 
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <shared_mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <OrbiterSDK.h>
-#include "EnjoLib\ModuleMessagingExtBase.hpp"
-#include "MMExt2\__MMExt2_MMStruct.hpp"
+#include "EnjoLib/ModuleMessagingExtBase.hpp"
+#include "MMExt2/__MMExt2_MMStruct.hpp"
+#include "MMExt2/__MMExt2_Types.hpp"
 
+#ifdef _WIN32
 #define DLLEXPIMP __declspec(dllexport)
+#else
+#define DLLEXPIMP
+#endif
+#define STR_CLASSES 9      // string value size classes, 16 bytes up to 4K
 
 using namespace std;
 
@@ -47,6 +62,32 @@ namespace MMExt2
 	Developer Instructions:
 
 	None. Do not try to call this directly. This is always in MMExt2.dll and called through the static entry points from the _MMExt2_Internal implementation
+
+	The entry points live in MMExt2_Orbiter.cpp. The core itself only needs the few oapi calls stubbed in Headless, so
+	it also builds as a plain library (see CMakeLists.txt at the top of the tree) for profiling and sanitizer runs.
+
+	Threading:
+
+	Put, Get, Delete, Find and the log calls are safe from any thread. The store is split into shards by key hash, each
+	with its own reader/writer lock over its index and the values of its keys, so concurrent Gets only share a lock with
+	writers to the same shard. Resolve (and every v1 call) asks Orbiter whether the vessel handle is live, so worker
+	threads should resolve their keys on the sim thread and then use the key-based v2 calls.
+
+	Lock order: index lock, then a shard lock, then the entry grow lock or the log lock. Logging never happens with a
+	shard lock held.
+
+	Memory:
+
+	Entries come in fixed blocks of BLOCK_SIZE, variable names from one bump arena and module names from the client
+	table, so interning a key costs no allocation of its own. String values come from a per shard pool of size classes.
+	ResetSession hands the lot back in a few frees, and MemStats reports how much is reserved against how much is in use.
+
+	Vessel lifetime:
+
+	By default every access to a key checks that its vessel (and any stored OBJHANDLE value) is still live, through an
+	SEH guarded oapiGetObjectType, and expunges the key when it is not. Once a client declares with VesselEvents that
+	it forwards its clbkDeleteVessel calls to VesselDeleted, the core trusts those events instead: each deletion purges
+	the vessel's keys in one sweep of the vessel index, and Resolve, Get and Find stop probing handles.
 */
 
 	class MMExt2_Core
@@ -55,60 +96,507 @@ namespace MMExt2
 		MMExt2_Core();
 		virtual ~MMExt2_Core();
 
-    static bool Put(const string& cli, const string& id, const bool& val);
-    static bool Put(const string& cli, const string& id, const int& val);
-    static bool Put(const string& cli, const string& id, const double& val);
-    static bool Put(const string& cli, const string& id, const string& val);
-    static bool Put(const string& cli, const string& id, const VECTOR3& val);
-    static bool Put(const string& cli, const string& id, const MATRIX3& val);
-    static bool Put(const string& cli, const string& id, const MATRIX4& val);
-    static bool Put(const string& cli, const string& id, const OBJHANDLE& val);
-    static bool Put(const string& cli, const string& id, const MMStruct* val);
-    static bool Put(const string& cli, const string& id, const EnjoLib::ModuleMessagingExtBase* val);
-
-    static bool Get(const string& cli, const string& id, int* val);
-    static bool Get(const string& cli, const string& id, bool* val);
-    static bool Get(const string& cli, const string& id, double* val);
-    static bool Get(const string& cli, const string& id, string* val);
-    static bool Get(const string& cli, const string& id, VECTOR3* val);
-    static bool Get(const string& cli, const string& id, MATRIX3* val);
-    static bool Get(const string& cli, const string& id, MATRIX4* val);
-    static bool Get(const string& cli, const string& id, OBJHANDLE* val);
-    static bool Get(const string& cli, const string& id, const MMStruct** val);
-    static bool Get(const string& cli, const string& id, const EnjoLib::ModuleMessagingExtBase** val);
-
-    static int ObjType(const string& cli, const string& id, const OBJHANDLE& val);
-
-    static bool MMExt2_Core::Delete(const string& cli, const string& id, const char& c = '\0');
+    static bool Resolve(const char* mod, const char* var, const OBJHANDLE ohv, MMKey* key);
+    // Resolve for a by-name read: finds the key only if a Put has made it, and never adds one. A miss is logged for cli
+    // as a failed act on the names, and leaves key invalid.
+    static bool LookupKey(const char* cli, const char act, const char* mod, const char* var, const OBJHANDLE ohv, MMKey* key);
+
+    static bool Put(const MMKey& key, const bool& val);
+    static bool Put(const MMKey& key, const int& val);
+    static bool Put(const MMKey& key, const double& val);
+    static bool Put(const MMKey& key, const char* val);
+    static bool Put(const MMKey& key, const VECTOR3& val);
+    static bool Put(const MMKey& key, const MATRIX3& val);
+    static bool Put(const MMKey& key, const MATRIX4& val);
+    static bool Put(const MMKey& key, const OBJHANDLE& val);
+    static bool Put(const MMKey& key, const MMStruct* val);
+    static bool Put(const MMKey& key, const EnjoLib::ModuleMessagingExtBase* val);
+
+    static bool Get(const char* cli, const MMKey& key, int* val);
+    static bool Get(const char* cli, const MMKey& key, bool* val);
+    static bool Get(const char* cli, const MMKey& key, double* val);
+    static bool Get(const char* cli, const MMKey& key, VECTOR3* val);
+    static bool Get(const char* cli, const MMKey& key, MATRIX3* val);
+    static bool Get(const char* cli, const MMKey& key, MATRIX4* val);
+    static bool Get(const char* cli, const MMKey& key, OBJHANDLE* val);
+    static bool Get(const char* cli, const MMKey& key, const MMStruct** val);
+    static bool Get(const char* cli, const MMKey& key, const EnjoLib::ModuleMessagingExtBase** val);
+
+    // Only copy the value (and log the call) if it has changed since generation *gen, which is then brought up to date.
+    // Generations count the changes to a key, so start from 0. A delete also moves the generation on.
+    static bool GetIfChanged(const char* cli, const MMKey& key, int* val, unsigned int* gen);
+    static bool GetIfChanged(const char* cli, const MMKey& key, bool* val, unsigned int* gen);
+    static bool GetIfChanged(const char* cli, const MMKey& key, double* val, unsigned int* gen);
+    static bool GetIfChanged(const char* cli, const MMKey& key, VECTOR3* val, unsigned int* gen);
+    static bool GetIfChanged(const char* cli, const MMKey& key, MATRIX3* val, unsigned int* gen);
+    static bool GetIfChanged(const char* cli, const MMKey& key, MATRIX4* val, unsigned int* gen);
+    static bool GetIfChanged(const char* cli, const MMKey& key, OBJHANDLE* val, unsigned int* gen);
+
+    // Strings without the temporary copy. GetRef points *val at the stored characters themselves (NUL-terminated, *len
+    // not counting the NUL), which stay put until the key's next Put or Delete. GetCopy copies them straight into the
+    // caller's buffer instead, setting *len to the size needed. With a gen, both only read when the key has changed.
+    static bool GetRef(const char* cli, const MMKey& key, const char** val, size_t* len, unsigned int* gen = NULL);
+    static bool GetCopy(const char* cli, const MMKey& key, char* val, size_t* len, unsigned int* gen = NULL);
+
+    static bool GetBatch(const char* cli, MMBatchItem* items, const size_t n);
+    static bool PutBatch(const string& cli, MMBatchItem* items, const size_t n);
+
+    static int ObjType(const string& cli, const MMKey& key, const OBJHANDLE& val);
+
+    static bool Delete(const string& cli, const MMKey& key, const char& c = '\0');
+    // Delete by name, for v1. The key is only looked up: a name nothing has Put has nothing to delete, which succeeds
+    // (as a delete of a deleted key does) without a log record, unless the names are bad or the vessel has gone.
+    static bool Delete(const char* cli, const char* mod, const char* var, const OBJHANDLE ohv);
     static bool Find(char* rTyp, string* rMod, string* rVar, OBJHANDLE* rOhv, int* ix, const string& cli, const string& mod, const string& var, const OBJHANDLE ohv, bool skp);
+    static bool Find(char* rTyp, string* rMod, string* rVar, OBJHANDLE* rOhv, MMCursor* cur, const string& cli, const string& mod, const string& var, const OBJHANDLE ohv, bool skp);
+    static bool Find(char* rTyp, const char** rMod, const char** rVar, OBJHANDLE* rOhv, MMCursor* cur, const string& cli, const string& mod, const string& var, const OBJHANDLE ohv, bool skp);
+    static bool FindAll(MMFindRec* rRec, size_t* nRec, char* rNames, size_t* lNames, const string& cli, const string& mod, const string& var, const OBJHANDLE ohv, bool skp);
 
+    // The const char** forms return names held by the core (or by Orbiter, for a vessel name), valid while the
+    // DLL is loaded (or the vessel exists), so nothing is copied.
     static bool GetVer(const char* mod, char* val, size_t *len);
+    static bool GetVer(const char* mod, const char** val);
     static bool GetLog(char *func, string *rCli, string *rMod, string* rVar, string* rVes, bool *success, int* ix, const string& cli, bool skp);
+    static bool GetLog(char *func, const char** rCli, const char** rMod, const char** rVar, const char** rVes, bool *success, int* ix, const string& cli, bool skp);
     static bool ResetLog();
+    static bool SetLogMode(const int mode, const unsigned int sample);
+    static bool Subscribe(unsigned int* id, const string& cli, const string& mod, const string& var, const OBJHANDLE ohv, MMNotifyFunc fn, void* ctx, const int mode, bool skp);
+    static bool Unsubscribe(const string& cli, const unsigned int id);
+    static bool Dispatch(const string& cli);
+    static bool VesselEvents(const string& cli, const bool on);
+    static bool VesselDeleted(const OBJHANDLE ohv);
+    static bool ObjCacheStats(unsigned long long* hits, unsigned long long* misses);
+    static int HandleType(const OBJHANDLE h);
+    static void SetSeqRead(const bool on);
+    static bool MemStats(size_t* reserved, size_t* used);
+    static bool ResetSession();
+    // The whole store to a file and back (format in MMExt2_Core.cpp). Snapshot writes the file in one plain write;
+    // Restore maps it and reads the records in place.
+    static bool Snapshot(const char* path);
+    static bool Restore(const char* path);
+
+    // Traffic recorder. While on, every Put and Delete is appended to a per thread buffer (the key handle, the type and
+    // the raw value bytes, plus a global sequence number and the sim time), and a background thread gathers the
+    // buffers and writes them out as compressed blocks. Replay feeds a recording back through Put in sequence order.
+    static bool RecordStart(const char* path);
+    static bool RecordStop();
+    static bool Replay(const char* path);
+
+    // Call counts for the ix'th client to have used the bus (in order of first use), with *cli its name. A Put through
+    // a key that does not resolve (say, one from before a ResetSession) has no module to count against, so it counts
+    // against "{unresolved}".
+    static bool GetStats(const unsigned int ix, const char** cli, const int op, MMStats* stats);
+    // Counts a call refused before it reached a key, e.g. a v1 Put whose names did not resolve, as a miss for cli
+    static bool Refused(const char* cli, const int op);
+
+    // The busiest keys by sampled Get and Put calls per sim second, busiest first (see MMHotKey), written as FindAll does,
+    // except that nKeys comes back as the keys filled in: those up to the first whose names did not fit
+    static bool HotKeys(MMHotKey* rKeys, size_t* nKeys, char* rNames, size_t* lNames);
+
+    // Writes every counted call (see MMStatOp) to a Chrome trace JSON file until TraceStop, on the host's steady clock
+    static bool TraceStart(const char* path);
+    static bool TraceStop();
 
 	protected:
 	private:
-    static bool Log(const string& cli, const string& act, const bool& res, const string& id);
-    static bool DeleteType(const string &id, const char type);
+    // Inline value for all fixed size types. A string short enough to fit (with its NUL) is held inline in s as well;
+    // a longer one goes in Entry::str.
+    union Value {
+      bool b;
+      int i;
+      double d;
+      VECTOR3 v;
+      MATRIX3 m3;
+      MATRIX4 m4;
+      OBJHANDLE o;
+      const MMStruct* x;
+      const EnjoLib::ModuleMessagingExtBase* y;
+      char s[sizeof(MATRIX4)];
+    };
+
+    // A string value of n characters. p is a block of cap bytes from the shard's StrPool, or NULL while the characters
+    // are inline in Value::s.
+    struct Str {
+      char* p;
+      unsigned int n;
+      unsigned int cap;
+    };
 
-    static bool ValidateObjHandle(const string& cli, const string& id, const OBJHANDLE obj);
+    // One entry per interned (ohv, mod, var) key. The key handle is the entry index + 1, tagged with the session in its
+    // top bits, and entries never move, so a type change or delete is done in place. typ is '\0' when the key has no
+    // value stored against it. mod points into the client table, and var into the name arena.
+    // ohv, mod, var and hash never change once the entry is published; typ, val and str are guarded by the shard lock.
+    // Writers also bump seq around every change to typ or val (odd while a write is in flight), so the numeric types
+    // can be read without the lock: copy, then retry if seq moved. seq / 2 is the key's generation, its change count.
+    struct Entry {
+      Entry() : seq(0), indexed(false), dead(false), rec(0) { str.p = NULL; str.n = str.cap = 0; };
+      OBJHANDLE ohv;
+      const string* mod;
+      const char* var;
+      unsigned int hash;
+      char typ;
+      Value val;
+      Str str;
+      atomic<unsigned int> seq;
+      atomic<bool> indexed;  // listed in the Find indexes, which a key is once its Intern is done
+      atomic<bool> dead;     // vessel deleted: no values, and Resolve only revives it if the handle is a vessel again
+      atomic<unsigned int> rec;  // recording its names were last written to, so each key's names go out once
+    };
 
-		template<class T> static bool SearchMap(const string& get, const string& id, const map<string, T>& mapToSearch, T* returnValue);
-    template<class T> static bool SearchMapDelete(const string &id, map<string, T>& mapToSearch);
-    template<class T> static bool PutMap(const string& cli, const string& id, const char& typ, map<string, T> &mapToStore, const T &val);
+    // Open addressing index slot: cached hash plus entry handle (0 = empty slot)
+    struct Slot {
+      unsigned int hash;
+      unsigned int h;
+    };
+
+    // Chunked bump allocator. Nothing is given back singly: Release drops all the chunks at once. Not thread safe on
+    // its own, so each arena sits behind the lock of whatever owns it.
+    struct Arena {
+      Arena() : next(NULL), left(0), reserved(0), used(0) {};
+      void* Alloc(size_t n);
+      void Release();
+      vector<unique_ptr<char[]>> chunks;
+      char* next;
+      size_t left;
+      size_t reserved;
+      size_t used;
+    };
+
+    // String value blocks for one shard, in power of two size classes carved from an arena and recycled through a free
+    // list per class. A string too long for the largest class gets a heap block of its own. Guarded by the shard lock.
+    struct StrPool {
+      StrPool();
+      char* Alloc(size_t n, unsigned int* cap);
+      void Free(char* p, unsigned int cap);
+      void Release();
+      Arena arena;
+      char* free[STR_CLASSES];
+      unordered_set<char*> big;
+      size_t bigBytes;
+      size_t used;
+    };
+
+    // One slice of the store, picked by the top bits of the key hash
+    struct Shard {
+      Shard() : count(0) {};
+      shared_timed_mutex lock;
+      vector<Slot> slots;
+      unsigned int count;
+      StrPool strs;
+      unordered_map<OBJHANDLE, vector<unsigned int>> objs;  // keys of this shard holding each OBJHANDLE value
+    };
+
+    // Compact activity log record. Names are only looked up and formatted when the log is read back via GetLog.
+    struct LogRec {
+      double simt;
+      unsigned int cli;
+      unsigned int h;
+      char act;
+      bool res;
+      bool dedup;
+      bool query;  // h is a LogQuery index rather than a key handle
+    };
+
+    // Names of a logged call that never reached a key: a miss, or a query with wildcards. They are kept here rather
+    // than interned, so polling a name nobody has Put costs no store entry.
+    struct Query {
+      OBJHANDLE ohv;
+      string mod;
+      string var;
+      unsigned int hash;
+    };
+
+    static bool Log(const char* cli, const char act, const bool& res, const OBJHANDLE ohv, const char* mod, const char* var);
+    static bool Log(const char* cli, const char act, const bool& res, const MMKey& key);
+    static bool Record(const char* cli, const char act, const bool& res, const unsigned int h, const bool query = false);
+    static unsigned int LogQuery(const OBJHANDLE ohv, const char* mod, const char* var);
+    static void LoadConfig();
+
+    // Per client call counters, in step with m_clis. Each is bumped by the calling thread with a relaxed add.
+    struct OpStats {
+      OpStats();
+      atomic<unsigned long long> calls;
+      atomic<unsigned long long> misses;
+      atomic<unsigned long long> bytes;
+      atomic<unsigned long long> hist[MMSTAT_BUCKETS];
+    };
+    struct CliStats {
+      OpStats op[MMSTAT_OPS];
+    };
+    static unsigned int Client(const char* cli, CliStats** stats = NULL);
+    static unsigned long long StatBegin();
+
+    // Hot key profiler: space-saving summaries over the Gets and Puts sampled for the stats. Each tracks the HOT_SLOTS
+    // keys with the most calls; a new key takes over the least called slot, and inherits its count as err.
+    struct HotSlot {
+      unsigned int h;
+      unsigned long long n;
+      unsigned long long err;
+      unsigned long long gets;
+      unsigned long long puts;
+    };
+    // Each sampling thread keeps its own summary, whose lock only HotKeys and ResetSession contend for, and HotKeys
+    // merges them. A thread that exits adds what it had to m_hotLeft.
+    struct HotTable {
+      HotTable();
+      ~HotTable();
+      mutex lock;
+      vector<HotSlot> slots;
+      unordered_map<unsigned int, size_t> ixs;
+      double from;  // sim time of the first sample
+    };
+    static void Hot(const unsigned int h, const bool put);
+    static void HotDump();
+    static bool Stat(const char* cli, const int op, const unsigned long long t0, const bool res, const size_t bytes,
+                     const unsigned int h = 0);
+
+    static bool ValidateObjHandle(const MMKey& key, const OBJHANDLE obj);
+    static bool Live(const MMKey& key, const OBJHANDLE obj);
+    static bool Purge(const MMKey& key);
+    static void Notify(const MMKey& key, const Entry& e, const char typ);
+
+    static unsigned int Intern(const OBJHANDLE ohv, const char* mod, const char* var);
+    static unsigned int Lookup(const OBJHANDLE ohv, const char* mod, const char* var);
+    static void Index(const unsigned int h);
+    static unsigned int Probe(const Shard& sh, const unsigned int hash, const OBJHANDLE ohv, const char* mod, const char* var, size_t* pos);
+    static unsigned int NewEntry(const unsigned int hash, const OBJHANDLE ohv, const char* mod, const char* var);
+    static bool FindNext(MMCursor* cur, char* rTyp, const string& cli, const string& mod, const string& var, const OBJHANDLE ohv, bool skp);
+    static void Rehash(Shard& sh, const size_t slots);
+    static Entry* _Entry(const MMKey& key);
+    static unsigned int _Handle(const unsigned int ix);
+    static Shard& _Shard(const unsigned int hash);
+
+    template<class T> static T& _Val(Entry& e);
+    template<class T> static bool Holds(Entry& e, const T& val);
+    template<class T> static void Store(Shard& sh, Entry& e, const T& val);
+    static bool Holds(Entry& e, const char* val);
+    static void Store(Shard& sh, Entry& e, const char* val);
+    static void Clear(Shard& sh, Entry& e);
+    static void ObjLink(Shard& sh, const unsigned int h, const OBJHANDLE obj);
+    static void ObjUnlink(Shard& sh, const unsigned int h, const OBJHANDLE obj);
+    static const char* _Str(const Entry& e);
+    template<class T> static bool GetSlot(const char* cli, const MMKey& key, const char& typ, T* val, unsigned int* gen = NULL);
+    template<class T> static bool SeqGet(Entry& e, const char& typ, T* val, unsigned int* seq);
+    template<class T> struct SeqType { enum { value = 0 }; };  // set for the types read under the sequence counter
+    static void SeqBegin(Entry& e);
+    static void SeqEnd(Entry& e);
+    template<class T> static bool PutSlot(const MMKey& key, const char& typ, const T& val);
+    template<class T> static void RecPut(const MMKey& key, Entry& e, const char typ, const T& val);
+    static void RecPut(const MMKey& key, Entry& e, const char typ, const char* val);
+    static void Rec(const MMKey& key, Entry& e, const char typ, const void* val, const size_t len);
+    static void RecDrain(const bool all);
+    static void RecThread();
 
 		static const char m_token;
-		static map<string, bool> m_bools;
-		static map<string, int> m_ints;
-		static map<string, double> m_doubles;
-		static map<string, VECTOR3> m_VECTOR3s;
-		static map<string, MATRIX3> m_MATRIX3s;
-		static map<string, MATRIX4> m_MATRIX4s;
-    static map<string, string> m_strings;
-    static map<string, const MMStruct*> m_MMStructs;
-    static map<string, const EnjoLib::ModuleMessagingExtBase*> m_MMBases;
-    static map<string, OBJHANDLE> m_OBJHANDLEs;
-    static map<string, char> m_types;
-    static vector<string> m_activitylog;
+
+    // Fixed block table, so a handle lookup never races a table resize. m_count is published after the entry is
+    // built; m_grow serializes the (rare) creation of new entries across shards.
+    static unique_ptr<Entry[]> m_blocks[];
+    static atomic<unsigned int> m_count;
+    static atomic<unsigned int> m_session;
+    static mutex m_grow;
+    static Arena m_names;
+    static Shard m_shards[];
+
+    // Secondary indexes for Find. Each list holds handles in handle (so creation) order, and a cursor into one resumes
+    // after its last match by handle, so it stays valid while the store changes. A deleted vessel's list goes, and its
+    // keys leave the module and variable lists.
+    typedef vector<unsigned int> HandleList;
+    static unordered_map<string, HandleList> m_byMod;
+    static unordered_map<string, HandleList> m_byVar;
+    static unordered_map<OBJHANDLE, HandleList> m_byVes;
+    static shared_timed_mutex m_index;
+    static atomic<bool> m_seqRead;
+    static mutex m_vesLock;
+    static set<string> m_vesClis;          // clients forwarding vessel deletions
+    static atomic<bool> m_vesEvents;
+
+    // Per-thread memo of oapiGetObjectType results, good for one frame: an entry counts only while its frame stamp
+    // (m_frame, moved on by each Dispatch) and the vessel deletion generation both match. Until a client has called
+    // Dispatch there is no frame to go by, and every probe goes to Orbiter.
+    struct TypeMemo {
+      OBJHANDLE h;
+      unsigned int frame;
+      unsigned int gen;
+      int typ;
+    };
+    static thread_local TypeMemo m_typeMemo[];
+    static atomic<unsigned int> m_typeGen;
+    static atomic<unsigned int> m_frame;
+    static atomic<unsigned long long> m_typeHits;
+    static atomic<unsigned long long> m_typeMisses;
+
+    // Change subscriptions. A fully specified (mod, var, vessel) subscription is indexed by key handle, and a wildcard
+    // one by its module if it names one, else by its variable, else by its vessel, so a change is only matched against
+    // subscriptions that could want it. Put and Delete only take m_subLock shared, so writers do not queue behind each
+    // other here. Frame mode subscriptions collect each changed key once in pend (under their own pendLock) until their
+    // client calls Dispatch.
+    // calls counts the callbacks picked up for a subscription and not yet returned (or skipped, once it is retired).
+    // Unsubscribe waits for it to drain, bar those the calling thread holds itself, so once it returns nothing is
+    // using the subscription's ctx.
+    struct Sub {
+      Sub() : calls(0), retired(false) {};
+      unsigned int id;
+      string cli;
+      string mod;
+      string var;
+      OBJHANDLE ohv;
+      bool skp;
+      bool frame;
+      MMNotifyFunc fn;
+      void* ctx;
+      atomic<unsigned int> calls;
+      atomic<bool> retired;
+      mutex pendLock;
+      vector<unsigned int> pend;
+      unordered_set<unsigned int> pendSet;
+    };
+    struct Note {
+      shared_ptr<Sub> sub;
+      unsigned int h;
+    };
+    typedef vector<shared_ptr<Sub>> SubList;
+    static void SubIndex(const shared_ptr<Sub>& s, const MMKey& key);
+    static void SubMatch(const SubList& subs, const MMKey& key, const Entry& e, vector<Note>* now);
+    static void SubHold(const shared_ptr<Sub>& s, const unsigned int h, vector<Note>* now);
+    static void SubCall(const Note& n, const char* mod, const char* var, const OBJHANDLE ohv, const char typ);
+    static void SubDone(const Note& n);
+    static map<unsigned int, shared_ptr<Sub>> m_subs;
+    static unordered_map<unsigned int, SubList> m_subByKey;
+    static unordered_map<string, SubList> m_subByMod;
+    static unordered_map<string, SubList> m_subByVar;
+    static unordered_map<OBJHANDLE, SubList> m_subByVes;
+    static SubList m_subAll;
+    static shared_timed_mutex m_subLock;
+    static atomic<unsigned int> m_subCount;
+    static unsigned int m_subNext;
+    static thread_local vector<const Sub*> m_subHeld;  // one per calls count this thread holds
+
+    // Where the last v1 Find call left off, so an ix loop resumes rather than re-skipping ix matches
+    struct FindMemo {
+      FindMemo() : ohv(NULL), skp(false), ix(-2), session(0) {};
+      string cli;
+      string mod;
+      string var;
+      OBJHANDLE ohv;
+      bool skp;
+      int ix;
+      unsigned int session;
+      MMCursor before;
+      MMCursor after;
+    };
+    static thread_local FindMemo m_findMemo;
+
+    // The log itself sits behind m_logLock. In first-seen mode each thread also remembers the signatures it has
+    // already logged, so the steady state (the same calls every frame) never touches the shared log at all.
+    // m_logEpoch moves on whenever a signature may be logged again, which drops those per-thread memories.
+    struct CliRef {
+      unsigned int ix;
+      CliStats* stats;
+    };
+    struct LogSeen {
+      LogSeen() : epoch(0), statTick(0) { cliLast.stats = NULL; };
+      unsigned int epoch;
+      unordered_set<unsigned long long> sigs;
+      unordered_map<string, CliRef> clis;  // this thread's cache of the client table
+      unsigned int statTick;
+      string cliName;                      // the last client looked up, as a module mostly calls in runs of its own
+      CliRef cliLast;
+    };
+    static thread_local LogSeen m_logLocal;
+    static mutex m_logLock;
+    static atomic<unsigned int> m_logEpoch;
+    static atomic<int> m_logMode;
+    static atomic<unsigned int> m_logSample;
+    static atomic<unsigned int> m_logTick;
+    static vector<LogRec> m_log;
+    static size_t m_logHead;
+    static size_t m_logCount;
+    static unordered_set<unsigned long long> m_logSeen;
+    static shared_timed_mutex m_qryLock;
+    static deque<Query> m_qrys;       // up to QUERY_CAPACITY, until ResetSession: names past that go unlogged
+    static unordered_multimap<unsigned int, unsigned int> m_qryIxs;  // hash to index + 1
+    static shared_timed_mutex m_cliLock;
+    static deque<string> m_clis;      // a deque, so the names do not move as clients are added
+    static deque<CliStats> m_cliStats;
+    static unordered_map<string, unsigned int> m_cliIxs;
+    static thread_local HotTable m_hotLocal;
+    static mutex m_hotLock;             // over m_hotTables and m_hotLeft
+    static vector<HotTable*> m_hotTables;
+    static unordered_map<unsigned int, HotSlot> m_hotLeft;
+    static double m_hotLeftFrom;
+    static string m_hotDump;            // file to append the top keys to at each ResetSession, from MMExt2.cfg
+
+    // Recorder state. Each recording thread owns a RecBuf and only ever contends for its lock with the writer thread,
+    // which takes every buffer in turn (under m_recLock) and swaps out its contents. A buffer whose thread exits hands
+    // what is left to m_recLeft. m_recFile and the pending block belong to whoever holds m_recWrite.
+    struct RecBuf {
+      RecBuf();
+      ~RecBuf();
+      mutex lock;
+      vector<char> data;
+      bool woke;
+      unordered_map<OBJHANDLE, string> objNames;  // names of recorded object values, owner thread only
+      unsigned int objEpoch;                       // ... good while m_recEpoch and m_typeGen stay at these
+      unsigned int objGen;
+    };
+    static thread_local RecBuf m_recLocal;
+    static atomic<bool> m_recOn;
+    static atomic<unsigned int> m_recEpoch;
+    static atomic<unsigned long long> m_recSeq;
+    static mutex m_recLock;
+    static vector<RecBuf*> m_recBufs;
+    static vector<char> m_recLeft;
+    static condition_variable m_recWake;
+    static bool m_recStop;
+    static thread m_recThread;
+    static mutex m_recCtl;             // serializes RecordStart and RecordStop
+    static mutex m_recWrite;
+    static FILE* m_recFile;
+    static vector<char> m_recBlock;
+
+    // Tracer state. Each traced thread owns a ring of events: only it moves head, and only the writer thread (under
+    // m_trcLock) moves tail, so the hot path takes no lock. A full ring drops the event rather than wait. Names are
+    // looked up by the writer, from the client index and key handle.
+    struct TraceEv {
+      unsigned long long t0;
+      unsigned long long t1;
+      unsigned int cli;
+      unsigned int h;
+      unsigned int frame;
+      unsigned char op;
+      bool res;
+    };
+    struct TraceBuf {
+      TraceBuf();
+      ~TraceBuf();
+      unique_ptr<TraceEv[]> ring;
+      atomic<unsigned int> head;
+      atomic<unsigned int> tail;
+      unsigned int tid;
+      double frameAt;
+      unsigned int frame;
+    };
+    static void Trace(const unsigned int cli, const int op, const unsigned long long t0, const unsigned long long t1,
+                      const bool res, const unsigned int h);
+    static unsigned int TraceFrame();
+    static void TraceOut(const TraceBuf& b, const TraceEv& ev);
+    static void TraceDrain();
+    static void TraceThread();
+    static thread_local TraceBuf m_trcLocal;
+    static atomic<bool> m_trcOn;
+    static atomic<unsigned long long> m_trcDropped;
+    static mutex m_trcLock;            // the buffer list and the file
+    static vector<TraceBuf*> m_trcBufs;
+    static unsigned int m_trcTids;
+    static condition_variable m_trcWake;
+    static bool m_trcStop;
+    static thread m_trcThread;
+    static mutex m_trcCtl;             // serializes TraceStart and TraceStop
+    static FILE* m_trcFile;
+    static bool m_trcFirst;
+    static mutex m_trcFrameLock;
+    static double m_trcFrameAt;
+    static unsigned int m_trcFrame;
 	};
 }
@@ -0,0 +1,341 @@
+// ==============================================================
+//                ORBITER AUX LIBRARY: ModuleMessagingExt
+//                          DLL entry points
+//             http://sf.net/projects/enjomitchsorbit
+//
+// Allows Orbiter modules to communicate with each other,
+// using predefined module and variable names.
+//
+// Copyright  (C) 2014-2018 Szymon "Enjo" Ender and Andrew "ADSWNJ" Stokes
+//
+//                         All rights reserved
+//
+// ModuleMessagingExt is free software: you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// ModuleMessagingExt is distributed in the hope that it will
+// be useful, but WITHOUT ANY WARRANTY; without even the implied
+// warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with ModuleMessagingExt. If not, see
+// <http://www.gnu.org/licenses/>
+// ==============================================================
+
+#include "MMExt2_Core.hpp"
+#include "MMExt2/__MMExt2_Api.hpp"
+#include <cstring>
+
+using namespace MMExt2;
+using namespace std;
+
+// The Orbiter facing side of MMExt2.dll: the C entry points the client headers bind to (all at once through the table
+// at the bottom, or one by one with GetProcAddress), as thin wrappers around the core. Everything behind them (MMExt2_Core.cpp) is portable, and builds and runs headless against
+// the stub SDK in Headless (see CMakeLists.txt).
+extern MMExt2_Core gCore;
+
+inline void _RemoteCopy(char* rS, size_t *rLenS, const char* lS) {
+  size_t n = strlen(lS) + 1;
+  if (n <= *rLenS) memcpy(rS, lS, n);
+  *rLenS = n;
+}
+
+inline void _RemoteCopy(char* rS, size_t *rLenS, const string &lS) {
+  _RemoteCopy(rS, rLenS, lS.c_str());
+}
+
+// v1 entry points resolve the key on every call. The v2 entry points further down take a pre-resolved MMKey instead. 
+inline MMKey _Key(const char* mod, const char* var, const OBJHANDLE ohv) {
+  MMKey key;
+  gCore.Resolve(mod, var, ohv, &key);
+  return key;
+}
+
+// A v1 Put whose names do not resolve still counts, against the module putting
+template<class T> inline bool _Put(const char* mod, const char* var, const OBJHANDLE ohv, const T& val) {
+  MMKey key = _Key(mod, var, ohv);
+  return (key.IsValid() ? gCore.Put(key, val) : gCore.Refused(mod, MMSTAT_PUT));
+}
+
+// The v1 Gets only look the key up, as a read never adds one: polling names that nothing has Put costs no memory
+inline MMKey _Found(const char* cli, const char* mod, const char* var, const OBJHANDLE ohv) {
+  MMKey key;
+  gCore.LookupKey(cli, 'G', mod, var, ohv, &key);
+  return key;
+}
+
+// 
+// STATIC ENTRY POINTS FOR MMExt2_Internal
+// If you change this interface, make a new V2, V3 set of entry points and fix up the compatibility for all apps using these original ones. 
+//
+
+DLLCLBK bool ModMsgGet_ver_v1(                       const char* mod,                  char* val, size_t *len)                    { return gCore.GetVer(mod, val, len); };
+DLLCLBK bool ModMsgPut_int_v1(                       const char* mod, const char* var, const int& val,       const OBJHANDLE ohv) { return _Put(mod, var, ohv, val); }
+DLLCLBK bool ModMsgPut_bool_v1(                      const char* mod, const char* var, const bool& val,      const OBJHANDLE ohv) { return _Put(mod, var, ohv, val); }
+DLLCLBK bool ModMsgPut_double_v1(                    const char* mod, const char* var, const double& val,    const OBJHANDLE ohv) { return _Put(mod, var, ohv, val); }
+DLLCLBK bool ModMsgPut_VECTOR3_v1(                   const char* mod, const char* var, const VECTOR3& val,   const OBJHANDLE ohv) { return _Put(mod, var, ohv, val); }
+DLLCLBK bool ModMsgPut_MATRIX3_v1(                   const char* mod, const char* var, const MATRIX3& val,   const OBJHANDLE ohv) { return _Put(mod, var, ohv, val); }
+DLLCLBK bool ModMsgPut_MATRIX4_v1(                   const char* mod, const char* var, const MATRIX4& val,   const OBJHANDLE ohv) { return _Put(mod, var, ohv, val); }
+DLLCLBK bool ModMsgPut_OBJHANDLE_v1(                 const char* mod, const char* var, const OBJHANDLE& val, const OBJHANDLE ohv) { return _Put(mod, var, ohv, val); }
+DLLCLBK bool ModMsgPut_MMStruct_v1(                  const char* mod, const char* var, const MMStruct* val,  const OBJHANDLE ohv) { return _Put(mod, var, ohv, val); }
+DLLCLBK bool ModMsgPut_MMBase_v1(                    const char* mod, const char* var, const EnjoLib::ModuleMessagingExtBase* val, const OBJHANDLE ohv)
+                                                                                                                                  { return _Put(mod, var, ohv, val); }
+DLLCLBK bool ModMsgDel_any_v1(                       const char* mod, const char* var, const OBJHANDLE ohv)                       { return gCore.Delete(mod, mod, var, ohv); }
+DLLCLBK bool ModMsgGet_int_v1(      const char* cli, const char* mod, const char* var, int* val,             const OBJHANDLE ohv) { return gCore.Get(cli, _Found(cli, mod, var, ohv), val); }
+DLLCLBK bool ModMsgGet_bool_v1(     const char* cli, const char* mod, const char* var, bool* val,            const OBJHANDLE ohv) { return gCore.Get(cli, _Found(cli, mod, var, ohv), val); }
+DLLCLBK bool ModMsgGet_double_v1(   const char* cli, const char* mod, const char* var, double* val,          const OBJHANDLE ohv) { return gCore.Get(cli, _Found(cli, mod, var, ohv), val); }
+DLLCLBK bool ModMsgGet_VECTOR3_v1(  const char* cli, const char* mod, const char* var, VECTOR3* val,         const OBJHANDLE ohv) { return gCore.Get(cli, _Found(cli, mod, var, ohv), val); }
+DLLCLBK bool ModMsgGet_MATRIX3_v1(  const char* cli, const char* mod, const char* var, MATRIX3* val,         const OBJHANDLE ohv) { return gCore.Get(cli, _Found(cli, mod, var, ohv), val); }
+DLLCLBK bool ModMsgGet_MATRIX4_v1(  const char* cli, const char* mod, const char* var, MATRIX4* val,         const OBJHANDLE ohv) { return gCore.Get(cli, _Found(cli, mod, var, ohv), val); }
+DLLCLBK bool ModMsgGet_OBJHANDLE_v1(const char* cli, const char* mod, const char* var, OBJHANDLE* val,       const OBJHANDLE ohv) { return gCore.Get(cli, _Found(cli, mod, var, ohv), val); }
+DLLCLBK bool ModMsgGet_MMStruct_v1( const char* cli, const char* mod, const char* var, const MMStruct** val, const OBJHANDLE ohv) { return gCore.Get(cli, _Found(cli, mod, var, ohv), val); }
+DLLCLBK bool ModMsgGet_MMBase_v1(   const char* cli, const char* mod, const char* var, const EnjoLib::ModuleMessagingExtBase** val, const OBJHANDLE ohv)
+                                                                                                                                  { return gCore.Get(cli, _Found(cli, mod, var, ohv), val); }
+DLLCLBK int ModMsgObj_typ_v1(const OBJHANDLE& val)                                                                                { return gCore.HandleType(val); }
+
+
+// Special handling for all string functions (do not want to expose the string implementation across compiler versions due to lack of ABI; therefore use char* as the interface)
+
+DLLCLBK bool ModMsgPut_c_str_v1(const char* mod, const char* var, const char* val, const OBJHANDLE ohv) {
+  return _Put(mod, var, ohv, val);
+}
+
+DLLCLBK bool ModMsgGet_c_str_v1(const char* cli, const char* mod, const char* var, char *val, size_t *lVal, const OBJHANDLE ohv) {
+  return gCore.GetCopy(cli, _Found(cli, mod, var, ohv), val, lVal);
+}
+
+
+DLLCLBK bool ModMsgFind_v1(char *rTyp, char *rMod, size_t *lMod, char *rVar, size_t *lVar, OBJHANDLE* rOhv, int* ix,
+                           const char* cli, const char* mod, const char* var, const OBJHANDLE ohv, const bool skpSelf) {
+  string iCli = cli, iMod = mod, iVar = var, irMod, irVar;
+  if (!gCore.Find(rTyp, &irMod, &irVar, rOhv, ix, iCli, iMod, iVar, ohv, skpSelf)) return false;
+  _RemoteCopy(rMod, lMod, irMod);
+  _RemoteCopy(rVar, lVar, irVar);
+  return true;
+}
+
+DLLCLBK bool ModMsgFind_v2(char *rTyp, char *rMod, size_t *lMod, char *rVar, size_t *lVar, OBJHANDLE* rOhv, MMCursor* cur,
+                           const char* cli, const char* mod, const char* var, const OBJHANDLE ohv, const bool skpSelf) {
+  const char *irMod, *irVar;
+  MMCursor prev = *cur;
+  size_t lModIn = *lMod, lVarIn = *lVar;
+  if (!gCore.Find(rTyp, &irMod, &irVar, rOhv, cur, string(cli), string(mod), string(var), ohv, skpSelf)) return false;
+  _RemoteCopy(rMod, lMod, irMod);
+  _RemoteCopy(rVar, lVar, irVar);
+  if (*lMod > lModIn || *lVar > lVarIn) *cur = prev; // names did not fit, so leave the cursor for the retry
+  return true;
+}
+
+DLLCLBK bool ModMsgFindRef_v2(char *rTyp, const char** rMod, const char** rVar, OBJHANDLE* rOhv, MMCursor* cur,
+                              const char* cli, const char* mod, const char* var, const OBJHANDLE ohv, const bool skpSelf) {
+  return gCore.Find(rTyp, rMod, rVar, rOhv, cur, string(cli), string(mod), string(var), ohv, skpSelf);
+}
+
+DLLCLBK bool ModMsgFindAll_v2(MMFindRec* rRec, size_t* nRec, char* rNames, size_t* lNames,
+                              const char* cli, const char* mod, const char* var, const OBJHANDLE ohv, const bool skpSelf) {
+  return gCore.FindAll(rRec, nRec, rNames, lNames, string(cli), string(mod), string(var), ohv, skpSelf);
+}
+
+DLLCLBK bool ModMsgGet_log_v1(char* rFunc, 
+                              char* rCli, size_t* lCli,
+                              char* rMod, size_t* lMod,
+                              char* rVar, size_t* lVar,
+                              char* rVes, size_t* lVes,
+                              bool* rSucc, int *ix,
+                              const char* get, const bool skp ) {
+  const char *iCli, *iMod, *iVar, *iVes;
+  if (!gCore.GetLog(rFunc, &iCli, &iMod, &iVar, &iVes, rSucc, ix, get, skp)) return false;
+
+  _RemoteCopy(rCli, lCli, iCli);
+  _RemoteCopy(rMod, lMod, iMod);
+  _RemoteCopy(rVar, lVar, iVar);
+  _RemoteCopy(rVes, lVes, iVes);
+  return true;
+}
+
+DLLCLBK bool ModMsgGetLogRef_v2(char* rFunc, const char** rCli, const char** rMod, const char** rVar, const char** rVes, bool* rSucc, int* ix,
+                                const char* get, const bool skp) {
+  return gCore.GetLog(rFunc, rCli, rMod, rVar, rVes, rSucc, ix, get, skp);
+}
+
+DLLCLBK bool ModMsgGetVerRef_v2(const char* mod, const char** val) { return gCore.GetVer(mod, val); }
+DLLCLBK bool ModMsgRst_log_v1() { return gCore.ResetLog(); }
+DLLCLBK bool ModMsgSetLogMode_v2(const int mode, const unsigned int sample) { return gCore.SetLogMode(mode, sample); }
+
+DLLCLBK bool ModMsgSubscribe_v2(unsigned int* id, const char* cli, const char* mod, const char* var, const OBJHANDLE ohv, MMNotifyFunc fn, void* ctx, const int mode, const bool skpSelf) {
+  return gCore.Subscribe(id, string(cli), string(mod), string(var), ohv, fn, ctx, mode, skpSelf);
+}
+DLLCLBK bool ModMsgUnsubscribe_v2(const char* cli, const unsigned int id) { return gCore.Unsubscribe(string(cli), id); }
+DLLCLBK bool ModMsgDispatch_v2(const char* cli)                          { return gCore.Dispatch(string(cli)); }
+
+// Vessel lifetime events. MMExt2.dll is loaded by its clients rather than by Orbiter, so it gets no module callbacks of
+// its own: a client forwards them from its oapi::Module::clbkDeleteVessel, having declared so with VesselEvents.
+DLLCLBK bool ModMsgVesselEvents_v2(const char* cli, const bool on)       { return gCore.VesselEvents(string(cli), on); }
+DLLCLBK bool ModMsgVesselDeleted_v2(const OBJHANDLE ohv)                 { return gCore.VesselDeleted(ohv); }
+DLLCLBK bool ModMsgObjCacheStats_v2(unsigned long long* hits, unsigned long long* misses) { return gCore.ObjCacheStats(hits, misses); }
+DLLCLBK bool ModMsgMemStats_v2(size_t* reserved, size_t* used)           { return gCore.MemStats(reserved, used); }
+DLLCLBK bool ModMsgResetSession_v2()                                     { return gCore.ResetSession(); }
+DLLCLBK bool ModMsgSnapshot_v2(const char* path)                         { return gCore.Snapshot(path); }
+DLLCLBK bool ModMsgRestore_v2(const char* path)                          { return gCore.Restore(path); }
+DLLCLBK bool ModMsgRecordStart_v2(const char* path)                      { return gCore.RecordStart(path); }
+DLLCLBK bool ModMsgRecordStop_v2()                                       { return gCore.RecordStop(); }
+DLLCLBK bool ModMsgReplay_v2(const char* path)                           { return gCore.Replay(path); }
+DLLCLBK bool ModMsgHotKeys_v2(MMHotKey* rKeys, size_t* nKeys, char* rNames, size_t* lNames) {
+  return gCore.HotKeys(rKeys, nKeys, rNames, lNames);
+}
+DLLCLBK bool ModMsgTraceStart_v2(const char* path)                       { return gCore.TraceStart(path); }
+DLLCLBK bool ModMsgTraceStop_v2()                                        { return gCore.TraceStop(); }
+DLLCLBK bool ModMsgGetStats_v2(const unsigned int ix, const char** rCli, const int op, MMStats* stats) {
+  return gCore.GetStats(ix, rCli, op, stats);
+}
+
+//
+// V2 KEY HANDLE ENTRY POINTS
+// Resolve the (mod, var, ohv) key once, then Put and Get by the returned handle with no key string building per call.
+//
+
+DLLCLBK bool ModMsgResolve_v2(                       const char* mod, const char* var, MMKey* key,           const OBJHANDLE ohv) { return gCore.Resolve(mod, var, ohv, key); }
+DLLCLBK bool ModMsgPut_int_v2(                       const MMKey& key, const int& val)                                            { return gCore.Put(key, val); }
+DLLCLBK bool ModMsgPut_bool_v2(                      const MMKey& key, const bool& val)                                           { return gCore.Put(key, val); }
+DLLCLBK bool ModMsgPut_double_v2(                    const MMKey& key, const double& val)                                         { return gCore.Put(key, val); }
+DLLCLBK bool ModMsgPut_VECTOR3_v2(                   const MMKey& key, const VECTOR3& val)                                        { return gCore.Put(key, val); }
+DLLCLBK bool ModMsgPut_MATRIX3_v2(                   const MMKey& key, const MATRIX3& val)                                        { return gCore.Put(key, val); }
+DLLCLBK bool ModMsgPut_MATRIX4_v2(                   const MMKey& key, const MATRIX4& val)                                        { return gCore.Put(key, val); }
+DLLCLBK bool ModMsgPut_OBJHANDLE_v2(                 const MMKey& key, const OBJHANDLE& val)                                      { return gCore.Put(key, val); }
+DLLCLBK bool ModMsgGet_int_v2(      const char* cli, const MMKey& key, int* val)                                                  { return gCore.Get(cli, key, val); }
+DLLCLBK bool ModMsgGet_bool_v2(     const char* cli, const MMKey& key, bool* val)                                                 { return gCore.Get(cli, key, val); }
+DLLCLBK bool ModMsgGet_double_v2(   const char* cli, const MMKey& key, double* val)                                               { return gCore.Get(cli, key, val); }
+DLLCLBK bool ModMsgGet_VECTOR3_v2(  const char* cli, const MMKey& key, VECTOR3* val)                                              { return gCore.Get(cli, key, val); }
+DLLCLBK bool ModMsgGet_MATRIX3_v2(  const char* cli, const MMKey& key, MATRIX3* val)                                              { return gCore.Get(cli, key, val); }
+DLLCLBK bool ModMsgGet_MATRIX4_v2(  const char* cli, const MMKey& key, MATRIX4* val)                                              { return gCore.Get(cli, key, val); }
+DLLCLBK bool ModMsgGet_OBJHANDLE_v2(const char* cli, const MMKey& key, OBJHANDLE* val)                                            { return gCore.Get(cli, key, val); }
+
+DLLCLBK bool ModMsgGetIfChanged_int_v2(      const char* cli, const MMKey& key, int* val,       unsigned int* gen)                 { return gCore.GetIfChanged(cli, key, val, gen); }
+DLLCLBK bool ModMsgGetIfChanged_bool_v2(     const char* cli, const MMKey& key, bool* val,      unsigned int* gen)                 { return gCore.GetIfChanged(cli, key, val, gen); }
+DLLCLBK bool ModMsgGetIfChanged_double_v2(   const char* cli, const MMKey& key, double* val,    unsigned int* gen)                 { return gCore.GetIfChanged(cli, key, val, gen); }
+DLLCLBK bool ModMsgGetIfChanged_VECTOR3_v2(  const char* cli, const MMKey& key, VECTOR3* val,   unsigned int* gen)                 { return gCore.GetIfChanged(cli, key, val, gen); }
+DLLCLBK bool ModMsgGetIfChanged_MATRIX3_v2(  const char* cli, const MMKey& key, MATRIX3* val,   unsigned int* gen)                 { return gCore.GetIfChanged(cli, key, val, gen); }
+DLLCLBK bool ModMsgGetIfChanged_MATRIX4_v2(  const char* cli, const MMKey& key, MATRIX4* val,   unsigned int* gen)                 { return gCore.GetIfChanged(cli, key, val, gen); }
+DLLCLBK bool ModMsgGetIfChanged_OBJHANDLE_v2(const char* cli, const MMKey& key, OBJHANDLE* val, unsigned int* gen)                 { return gCore.GetIfChanged(cli, key, val, gen); }
+
+DLLCLBK bool ModMsgGetBatch_v2(    const char* cli, MMBatchItem* items, const size_t n)                                            { return gCore.GetBatch(cli, items, n); }
+DLLCLBK bool ModMsgPutBatch_v2(                      const char* mod, MMBatchItem* items, const size_t n)                         { return gCore.PutBatch(string(mod), items, n); }
+
+DLLCLBK bool ModMsgPut_c_str_v2(const MMKey& key, const char* val) {
+  return gCore.Put(key, val);
+}
+
+DLLCLBK bool ModMsgGet_c_str_v2(const char* cli, const MMKey& key, char *val, size_t *lVal) {
+  return gCore.GetCopy(cli, key, val, lVal);
+}
+
+// If the string does not fit, the generation is left where it was, so the retry with a bigger buffer copies it
+DLLCLBK bool ModMsgGetIfChanged_c_str_v2(const char* cli, const MMKey& key, char *val, size_t *lVal, unsigned int* gen) {
+  return gCore.GetCopy(cli, key, val, lVal, gen);
+}
+
+// Borrowed read: *val points into the core, valid until the key's next Put or Delete (so, read it in the same frame
+// step). *len is the length without the NUL. Give a gen to only read it when changed, or NULL to always read it.
+DLLCLBK bool ModMsgGetRef_c_str_v2(const char* cli, const MMKey& key, const char** val, size_t* len, unsigned int* gen) {
+  return gCore.GetRef(cli, key, val, len, gen);
+}
+
+// The same borrowed read by name, in one call: the key is looked up (never added) and read together
+DLLCLBK bool ModMsgGetRefByName_c_str_v2(const char* cli, const char* mod, const char* var, const char** val, size_t* len, const OBJHANDLE ohv) {
+  return gCore.GetRef(cli, _Found(cli, mod, var, ohv), val, len);
+}
+
+//
+// FUNCTION TABLE
+// Every entry point above, in one table, so a client looks up one export rather than each of them.
+//
+inline MMApi _Api() {
+  MMApi api;
+  api.version = MMEXT2_API_VERSION;
+  api.fPI = ModMsgPut_int_v1;
+  api.fPB = ModMsgPut_bool_v1;
+  api.fPD = ModMsgPut_double_v1;
+  api.fPV = ModMsgPut_VECTOR3_v1;
+  api.fP3 = ModMsgPut_MATRIX3_v1;
+  api.fP4 = ModMsgPut_MATRIX4_v1;
+  api.fPO = ModMsgPut_OBJHANDLE_v1;
+  api.fPS = ModMsgPut_c_str_v1;
+  api.fGI = ModMsgGet_int_v1;
+  api.fGB = ModMsgGet_bool_v1;
+  api.fGD = ModMsgGet_double_v1;
+  api.fGV = ModMsgGet_VECTOR3_v1;
+  api.fG3 = ModMsgGet_MATRIX3_v1;
+  api.fG4 = ModMsgGet_MATRIX4_v1;
+  api.fGO = ModMsgGet_OBJHANDLE_v1;
+  api.fGS = ModMsgGet_c_str_v1;
+  api.fDA = ModMsgDel_any_v1;
+  api.fVR = ModMsgGet_ver_v1;
+  api.fGL = ModMsgGet_log_v1;
+  api.fFA = ModMsgFind_v1;
+  api.fPY = NULL;               // MMBase is no longer offered to clients
+  api.fPX = ModMsgPut_MMStruct_v1;
+  api.fGY = NULL;               // MMBase is no longer offered to clients
+  api.fGX = ModMsgGet_MMStruct_v1;
+  api.fRL = ModMsgRst_log_v1;
+  api.fOT = ModMsgObj_typ_v1;
+  api.fRK = ModMsgResolve_v2;
+  api.fPIK = ModMsgPut_int_v2;
+  api.fPBK = ModMsgPut_bool_v2;
+  api.fPDK = ModMsgPut_double_v2;
+  api.fPVK = ModMsgPut_VECTOR3_v2;
+  api.fP3K = ModMsgPut_MATRIX3_v2;
+  api.fP4K = ModMsgPut_MATRIX4_v2;
+  api.fPOK = ModMsgPut_OBJHANDLE_v2;
+  api.fPSK = ModMsgPut_c_str_v2;
+  api.fGIK = ModMsgGet_int_v2;
+  api.fGBK = ModMsgGet_bool_v2;
+  api.fGDK = ModMsgGet_double_v2;
+  api.fGVK = ModMsgGet_VECTOR3_v2;
+  api.fG3K = ModMsgGet_MATRIX3_v2;
+  api.fG4K = ModMsgGet_MATRIX4_v2;
+  api.fGOK = ModMsgGet_OBJHANDLE_v2;
+  api.fGSK = ModMsgGet_c_str_v2;
+  api.fSL = ModMsgSetLogMode_v2;
+  api.fFC = ModMsgFind_v2;
+  api.fFL = ModMsgFindAll_v2;
+  api.fGM = ModMsgGetBatch_v2;
+  api.fPM = ModMsgPutBatch_v2;
+  api.fSB = ModMsgSubscribe_v2;
+  api.fUS = ModMsgUnsubscribe_v2;
+  api.fDS = ModMsgDispatch_v2;
+  api.fVE = ModMsgVesselEvents_v2;
+  api.fVD = ModMsgVesselDeleted_v2;
+  api.fOS = ModMsgObjCacheStats_v2;
+  api.fCI = ModMsgGetIfChanged_int_v2;
+  api.fCB = ModMsgGetIfChanged_bool_v2;
+  api.fCD = ModMsgGetIfChanged_double_v2;
+  api.fCV = ModMsgGetIfChanged_VECTOR3_v2;
+  api.fC3 = ModMsgGetIfChanged_MATRIX3_v2;
+  api.fC4 = ModMsgGetIfChanged_MATRIX4_v2;
+  api.fCO = ModMsgGetIfChanged_OBJHANDLE_v2;
+  api.fCS = ModMsgGetIfChanged_c_str_v2;
+  api.fRS = ModMsgGetRef_c_str_v2;
+  api.fRV = ModMsgGetVerRef_v2;
+  api.fRG = ModMsgGetLogRef_v2;
+  api.fRF = ModMsgFindRef_v2;
+  api.fMS = ModMsgMemStats_v2;
+  api.fSR = ModMsgResetSession_v2;
+  api.fSN = ModMsgSnapshot_v2;
+  api.fRE = ModMsgRestore_v2;
+  api.fRB = ModMsgRecordStart_v2;
+  api.fRX = ModMsgRecordStop_v2;
+  api.fRP = ModMsgReplay_v2;
+  api.fTB = ModMsgTraceStart_v2;
+  api.fTX = ModMsgTraceStop_v2;
+  api.fST = ModMsgGetStats_v2;
+  api.fHK = ModMsgHotKeys_v2;
+  api.fRN = ModMsgGetRefByName_c_str_v2;
+  return api;
+}
+const MMApi gApi = _Api();
+
+// The table, for a client built against MMExt2/__MMExt2_Api.hpp at this version or earlier. NULL for a later one.
+DLLCLBK const MMApi* ModMsgGetApi_v2(const unsigned int version) { return (version <= gApi.version ? &gApi : NULL); }